@@ -4,6 +4,9 @@
 .set MAGIC,         0x1badb002
 .set CHECKSUM,      -(MAGIC + FLAGS)
 
+.set KERNEL_BASE,   0xc0000000 // Keep in sync with paging::KERNEL_BASE.
+.set PAGE_PRESENT_WRITABLE, 0x3
+
 .section .multiboot
 .align 4
 .long MAGIC
@@ -11,24 +14,84 @@
 .long CHECKSUM
 
 .section .bss
+.align 4096
+boot_page_directory:
+.skip 4096
+boot_page_table:
+.skip 4096
+
 .align 16
 stack_bottom:
 .skip 16384
 stack_top:
 
-.section .text
+// The bootloader jumps here with paging disabled, so this code
+// is linked at its physical address and has to use physical
+// addresses of everything in the higher half.
+.section .boot.text, "ax"
 .global _start
 .type _start, @function
 _start:
         cli
+
+        // Map the first 4MiB of memory both at 0, for the code here,
+        // and at KERNEL_BASE. The bootloader zeroed the .bss.
+        mov     $(boot_page_table - KERNEL_BASE), %edi
+        mov     $PAGE_PRESENT_WRITABLE, %esi
+        mov     $1024, %ecx
+1:      mov     %esi, (%edi)
+        add     $4096, %esi
+        add     $4, %edi
+        loop    1b
+
+        mov     $(boot_page_table - KERNEL_BASE + PAGE_PRESENT_WRITABLE), %ecx
+        mov     %ecx, boot_page_directory - KERNEL_BASE
+        mov     %ecx, boot_page_directory - KERNEL_BASE + (KERNEL_BASE >> 22) * 4
+
+        mov     $(boot_page_directory - KERNEL_BASE), %ecx
+        mov     %ecx, %cr3
+        mov     %cr0, %ecx
+        or      $0x80000000, %ecx
+        mov     %ecx, %cr0
+
+        mov     $higher_half, %ecx
+        jmp     *%ecx
+
+.size _start, . - _start
+
+// void load_page_tables(uint32_t cr3, uint32_t cr4)
+//
+// Switch to new page tables and paging mode. CR4.PAE cannot change
+// while paging is enabled, so it is turned off in between. Must be
+// identity mapped by both the old and the new tables.
+.global load_page_tables
+.type load_page_tables, @function
+load_page_tables:
+        mov     4(%esp), %ecx
+        mov     8(%esp), %edx
+
+        mov     %cr0, %eax
+        and     $0x7fffffff, %eax
+        mov     %eax, %cr0
+
+        mov     %edx, %cr4
+        mov     %ecx, %cr3
+
+        or      $0x80000000, %eax
+        mov     %eax, %cr0
+        ret
+
+.size load_page_tables, . - load_page_tables
+
+.section .text
+higher_half:
         mov     $stack_top, %esp
 
+        add     $KERNEL_BASE, %ebx
         push    %eax   // Multiboot magic number.
-        push    %ebx   // Multiboot info pointer.
+        push    %ebx   // Multiboot info pointer, moved to the physmap.
         call    kmain
 
         cli
 1:      hlt
         jmp     1b
-
-.size _start, . - _start
@@ -0,0 +1,39 @@
+#include <arch/i386/cpu.hpp>
+
+#include <arch/i386/asm.hpp>
+#include <util/bits.hpp>
+
+namespace cpu {
+    static uint32_t get_max_extended_leaf() {
+        return cpuid(0x8000'0000).eax;
+    }
+
+    static uint32_t get_max_leaf() {
+        return cpuid(0).eax;
+    }
+
+    bool has_feature(Feature feature) {
+        switch (feature) {
+        case Feature::PSE:
+            return get_bit(cpuid(1).edx, 3);
+        case Feature::PAE:
+            return get_bit(cpuid(1).edx, 6);
+        case Feature::NX:
+            return get_max_extended_leaf() >= 0x8000'0001
+                && get_bit(cpuid(0x8000'0001).edx, 20);
+        case Feature::ERMS:
+            return get_max_leaf() >= 7
+                && get_bit(cpuid(7).ebx, 9);
+        }
+        return false;
+    }
+
+    unsigned get_physical_address_bits() {
+        if (get_max_extended_leaf() >= 0x8000'0008) {
+            return get_bit_range(cpuid(0x8000'0008).eax, 0, 8);
+        }
+
+        // What PAE started with.
+        return has_feature(Feature::PAE) ? 36 : 32;
+    }
+}
@@ -5,6 +5,7 @@
 #include <arch/i386/idt.hpp>
 #include <kernel/kpanic.hpp>
 #include <kernel/log.hpp>
+#include <memory/heap_pages.hpp>
 #include <util/array.hpp>
 #include <util/bits.hpp>
 
@@ -38,8 +39,7 @@ static void report_page_fault(int selector) {
 
     const char* ring = userspace ? "userspace" : "kernel";
 
-    size_t address;
-    asm volatile("movl %%cr2, %0" : "=r"(address));
+    size_t address = read_cr2();
     LOG_ERROR("Trying to {} address {} by {}",
         action, reinterpret_cast<void*>(address), ring);
 
@@ -151,6 +151,12 @@ static void general_protection_fault(idt::InterruptFrame* frame, int selector) {
 
 __attribute__((interrupt))
 static void page_fault(idt::InterruptFrame* frame, int error_code) {
+    bool present = get_bit(error_code, 0);
+    bool userspace = get_bit(error_code, 2);
+    if (!present && !userspace && heap::handle_page_fault(read_cr2())) {
+        return;
+    }
+
     unhandled_exception("Page fault", frame,
         ErrorCodeType::PAGE_FAULT, error_code);
 }
@@ -1,7 +1,12 @@
 #include <arch/i386/ide.hpp>
 
 #include <arch/i386/asm.hpp>
+#include <arch/i386/idt.hpp>
+#include <arch/i386/paging.hpp>
+#include <arch/i386/pic.hpp>
 #include <kernel/log.hpp>
+#include <kernel/spinlock.hpp>
+#include <memory/frame_allocator.hpp>
 #include <util/array.hpp>
 #include <util/bits.hpp>
 #include <util/inplace_vector.hpp>
@@ -31,15 +36,23 @@ namespace ide {
     // Offsets in the identification space (in uint16_t's).
     constexpr size_t IDENT_DEVICE_TYPE  = 0;
     constexpr size_t IDENT_MODEL        = 27;
+    constexpr size_t IDENT_MAX_MULTIPLE = 47; // Sectors per DRQ block in the low byte.
     constexpr size_t IDENT_FEATURES     = 49;
     constexpr size_t IDENT_MAX_LBA      = 60;
     constexpr size_t IDENT_COMMAND_SETS = 82;
     constexpr size_t IDENT_MAX_LBA_EXT  = 100;
 
+    constexpr uint16_t FEATURES_SUPPORTS_DMA = 1 << 8;
     constexpr uint16_t FEATURES_SUPPORTS_LBA = 1 << 9;
 
     constexpr uint32_t COMMAND_SETS_USES_48_BIT = 1 << 26;
 
+    // Sectors per command.
+    constexpr size_t MAX_SECTORS_LBA28 = 256;
+    constexpr size_t MAX_SECTORS_LBA48 = 65536;
+
+    constexpr uint64_t LBA28_LIMIT = 0x1000'0000;
+
     /*
     Base IO port is:
     - BAR0 for the primary channel;
@@ -78,15 +91,61 @@ namespace ide {
         CONTROL       = 0x22, // Write only.
     };
 
+    // Bus master registers, offsets from the bus master base IO port.
+    constexpr uint16_t BM_COMMAND   = 0x00;
+    constexpr uint16_t BM_STATUS    = 0x02;
+    constexpr uint16_t BM_PRD_TABLE = 0x04;
+
+    // Flags in the bus master Command register.
+    constexpr uint8_t BM_COMMAND_START = 0x01;
+    constexpr uint8_t BM_COMMAND_READ  = 0x08; // The drive writes to memory.
+
+    // Flags in the bus master Status register, the last two are cleared by writing 1.
+    constexpr uint8_t BM_STATUS_ACTIVE    = 0x01;
+    constexpr uint8_t BM_STATUS_ERROR     = 0x02;
+    constexpr uint8_t BM_STATUS_INTERRUPT = 0x04;
+
+    /**
+     * Physical Region Descriptor, one contiguous piece of a DMA
+     * transfer. It can not cross a 64KiB boundary.
+     */
+    struct [[gnu::packed]] PrdEntry {
+        uint32_t address;
+        uint16_t byte_count; // 0 is 64KiB.
+        uint16_t flags;
+    };
+    static_assert(sizeof(PrdEntry) == 8);
+
+    constexpr uint16_t PRD_END_OF_TABLE = 0x8000;
+    constexpr size_t PRD_BOUNDARY = 64 * 1024;
+
+    /**
+     * Every channel has a one-page table, it can not cross
+     * a 64KiB boundary either.
+     */
+    constexpr size_t PRD_MAX_ENTRIES = paging::PAGE_SIZE / sizeof(PrdEntry);
+
+    static bool dma_enabled = true;
+    static bool multiple_enabled = true;
+
     enum class Command {
-        READ_PIO        = 0x20,
-        READ_PIO_EXT    = 0x24,
-        WRITE_PIO       = 0x30,
-        WRITE_PIO_EXT   = 0x34,
-        IDENTIFY        = 0xec,
-        IDENTIFY_PACKET = 0xa1,
-        CACHE_FLUSH     = 0xe7,
-        CACHE_FLUSH_EXT = 0xea,
+        READ_PIO           = 0x20,
+        READ_PIO_EXT       = 0x24,
+        READ_DMA           = 0xc8,
+        READ_DMA_EXT       = 0x25,
+        READ_MULTIPLE      = 0xc4,
+        READ_MULTIPLE_EXT  = 0x29,
+        WRITE_PIO          = 0x30,
+        WRITE_PIO_EXT      = 0x34,
+        WRITE_DMA          = 0xca,
+        WRITE_DMA_EXT      = 0x35,
+        WRITE_MULTIPLE     = 0xc5,
+        WRITE_MULTIPLE_EXT = 0x39,
+        SET_MULTIPLE_MODE  = 0xc6,
+        IDENTIFY           = 0xec,
+        IDENTIFY_PACKET    = 0xa1,
+        CACHE_FLUSH        = 0xe7,
+        CACHE_FLUSH_EXT    = 0xea,
     };
 
     class Channel {
@@ -138,6 +197,54 @@ namespace ide {
             outb(control_base_port + 2, 2); // Set bit 1 in the control port.
         }
 
+        /**
+         * Let the drives raise `irq` and wait for it instead of polling
+         * while interrupts are enabled.
+         */
+        void enable_irqs(uint8_t irq, idt::Handler handler) {
+            idt::register_interrupt(pic::get_interrupt_vector(irq), handler);
+            pic::clear_mask(2); // The secondary PIC is cascaded through IRQ2.
+            pic::clear_mask(irq);
+
+            outb(control_base_port + 2, 0);
+            read_status(); // Drop an interrupt already pending.
+            uses_irqs = true;
+        }
+
+        /**
+         * Reading the status register acknowledges the interrupt.
+         */
+        void handle_irq() const {
+            irq_status = read_status();
+            if (bus_master_port) {
+                irq_bm_status = inb(bus_master_port + BM_STATUS);
+                outb(bus_master_port + BM_STATUS, BM_STATUS_INTERRUPT);
+            }
+            stats.irqs++;
+            __atomic_store_n(&irq_received, true, __ATOMIC_RELEASE);
+        }
+
+        /**
+         * Expect an interrupt for the next step of a command. Call before
+         * the command or the data transfer that makes the drive raise it.
+         */
+        void arm_irq() const {
+            __atomic_store_n(&irq_received, false, __ATOMIC_RELAXED);
+        }
+
+        /**
+         * Wait for the step armed with `arm_irq`, sleeping until
+         * the interrupt if possible, polling otherwise.
+         */
+        PollingResult wait(bool advanced_check) const {
+            if (!can_sleep()) {
+                return poll(advanced_check);
+            }
+
+            sleep_until_irq();
+            return check_status(irq_status, advanced_check);
+        }
+
         // Need to add 400ns delays before all the status registers are up to date.
         // https://wiki.osdev.org/ATA_PIO_Mode#400ns_delays
         void delay_400ns() const {
@@ -160,66 +267,352 @@ namespace ide {
         }
 
         PollingResult poll(bool advanced_check) const {
+            uint64_t start = rdtsc();
             delay_400ns();
             wait_not_busy();
+            stats.wait_ticks += rdtsc() - start;
 
-            if (advanced_check) {
-                uint8_t status = read_status();
-                if (status & STATUS_ERROR) {
-                    return PollingResult::ERROR;
-                }
+            return check_status(read_status(), advanced_check);
+        }
 
-                if (status & STATUS_DRIVE_WRITE_FAULT) {
-                    return PollingResult::DRIVE_WRITE_FAULT;
-                }
+        /**
+         * Errors are always checked, `advanced_check`
+         * also requires the drive to be ready for data.
+         */
+        PollingResult check_status(uint8_t status, bool advanced_check) const {
+            if (status & STATUS_ERROR) {
+                return PollingResult::ERROR;
+            }
 
-                // No errors, but request is not ready.
-                if ((status & STATUS_REQUEST_READY) == 0) {
-                    return PollingResult::REQUEST_NOT_READY;
-                }
+            if (status & STATUS_DRIVE_WRITE_FAULT) {
+                return PollingResult::DRIVE_WRITE_FAULT;
+            }
+
+            // No errors, but request is not ready.
+            if (advanced_check && (status & STATUS_REQUEST_READY) == 0) {
+                return PollingResult::REQUEST_NOT_READY;
             }
 
             return PollingResult::SUCCESS;
         }
 
-        PollingResult read_sectors(uint8_t sector_count, Span<uint8_t> buffer) const {
-            size_t bytes_read = 0;
+        /**
+         * Read `sector_count` sectors, `block_size` of them per DRQ block
+         * (1 unless the command is READ MULTIPLE).
+         */
+        PollingResult read_sectors(size_t sector_count, uint8_t block_size, Span<uint8_t> buffer) const {
+            ASSERT(buffer.get_size() >= sector_count * 512u);
 
-            for (uint8_t i = 0; i < sector_count; i++) {
-                PollingResult result = poll(true);
+            // Armed before the command for the first block.
+            for (size_t i = 0; i < sector_count; i += block_size) {
+                PollingResult result = wait(true);
                 if (result != PollingResult::SUCCESS) {
                     return result;
                 }
 
-                for (int j = 0; j < 256; j++) {
-                    uint16_t word = read_data();
-                    buffer[bytes_read] = get_bit_range(word, 0, 8);
-                    buffer[bytes_read + 1] = get_bit_range(word, 8, 8);
-                    bytes_read += 2;
-                }
+                arm_irq();
+                size_t sectors = min<size_t>(block_size, sector_count - i);
+                insw(base_port, buffer.begin() + i * 512u, sectors * 256);
             }
 
             return PollingResult::SUCCESS;
         }
 
-        PollingResult write_sectors(uint8_t sector_count, Span<uint8_t> buffer) const {
-            size_t bytes_written = 0;
+        PollingResult write_sectors(size_t sector_count, uint8_t block_size, Span<uint8_t> buffer) const {
+            ASSERT(buffer.get_size() >= sector_count * 512u);
 
-            for (uint8_t i = 0; i < sector_count; i++) {
-                poll(false);
-                for (int j = 0; j < 256; j++) {
-                    write_data(buffer[bytes_written] |
-                        (buffer[bytes_written + 1] << 8));
-                    bytes_written += 2;
+            for (size_t i = 0; i < sector_count; i += block_size) {
+                // There is no interrupt before the first block.
+                PollingResult result = i == 0 ? poll(true) : wait(true);
+                if (result != PollingResult::SUCCESS) {
+                    return result;
                 }
+
+                arm_irq();
+                size_t sectors = min<size_t>(block_size, sector_count - i);
+                outsw(base_port, buffer.begin() + i * 512u, sectors * 256);
             }
 
+            // The interrupt for the last block must not be taken for the next
+            // command's, and the drive may still reject the data.
+            return wait(false);
+        }
+
+        /**
+         * Allocate the PRD table. Call once the bus master port is known.
+         */
+        void init_dma() {
+            // Accessed through the physmap.
+            auto frame = frame_allocator::allocate_contiguous(1, paging::PHYSMAP_SIZE - 1);
+            if (!frame.has_value()) {
+                LOG_WARN("No memory for an IDE PRD table, the channel will use PIO.");
+                return;
+            }
+
+            prd_table_address = frame.get_value();
+            prd_table = paging::to_virtual<PrdEntry>(frame.get_value());
+        }
+
+        /**
+         * Set the bus master up for a transfer of up to `size` bytes at `buffer`.
+         * Return the number of bytes it will transfer, whole sectors, the PRD
+         * table may not fit all of them. Return 0 if the buffer can not be
+         * used for DMA, the transfer then has to be done with PIO.
+         */
+        size_t prepare_dma(Direction direction, Span<uint8_t> buffer, size_t size) const {
+            return prepare_dma(direction, { &buffer, 1 }, 0, size);
+        }
+
+        /**
+         * Like the above, but for a scatter-gather list, skipping
+         * the first `skip` bytes.
+         */
+        size_t prepare_dma(
+            Direction direction, Span<const Span<uint8_t>> buffers,
+            size_t skip, size_t size) const
+        {
+            if (!prd_table) {
+                return 0;
+            }
+
+            size_t prepared = build_prd_table(buffers, skip, size);
+            if (prepared == 0) {
+                return 0;
+            }
+
+            outl(bus_master_port + BM_PRD_TABLE, prd_table_address);
+            outb(bus_master_port + BM_COMMAND, get_dma_command(direction));
+            outb(bus_master_port + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+            return prepared;
+        }
+
+        /**
+         * Start the transfer set up by `prepare_dma`, once the command
+         * is sent, and wait until it is done.
+         */
+        PollingResult run_dma(Direction direction) const {
+            start_dma(direction);
+
+            uint8_t bm_status;
+            if (can_sleep()) {
+                sleep_until_irq();
+                bm_status = irq_bm_status;
+            } else {
+                bm_status = poll_dma();
+            }
+
+            uint64_t start = rdtsc();
+            bm_status |= stop_dma(direction);
+            wait_not_busy();
+            stats.wait_ticks += rdtsc() - start;
+
+            uint8_t status = read_status();
+
+            if (status & STATUS_DRIVE_WRITE_FAULT) {
+                return PollingResult::DRIVE_WRITE_FAULT;
+            }
+            if ((status & STATUS_ERROR) || (bm_status & BM_STATUS_ERROR)) {
+                return PollingResult::ERROR;
+            }
             return PollingResult::SUCCESS;
         }
 
+        /**
+         * Start the transfer set up by `prepare_dma`, once the command is sent.
+         */
+        void start_dma(Direction direction) const {
+            outb(bus_master_port + BM_COMMAND, get_dma_command(direction) | BM_COMMAND_START);
+        }
+
+        /**
+         * Stop the bus master and clear its status, return the status.
+         */
+        uint8_t stop_dma(Direction direction) const {
+            outb(bus_master_port + BM_COMMAND, get_dma_command(direction));
+            uint8_t bm_status = inb(bus_master_port + BM_STATUS);
+            outb(bus_master_port + BM_STATUS, BM_STATUS_ERROR | BM_STATUS_INTERRUPT);
+            return bm_status;
+        }
+
+        bool is_dma_active() const {
+            uint8_t bm_status = inb(bus_master_port + BM_STATUS);
+            return (bm_status & BM_STATUS_ACTIVE) && !(bm_status & BM_STATUS_ERROR);
+        }
+
+        /**
+         * Without interrupts enabled, nothing would wake the CPU up.
+         */
+        bool can_sleep() const {
+            return uses_irqs && are_interrupts_enabled();
+        }
+
         uint16_t base_port;
         uint16_t control_base_port;
         uint16_t bus_master_port;
+
+        PrdEntry* prd_table = nullptr;
+        uint32_t prd_table_address = 0;
+
+        bool uses_irqs = false;
+
+        // Updated by const methods, transfers do not change the channel otherwise.
+        mutable ChannelStats stats = {};
+        mutable bool irq_received = false;
+        mutable uint8_t irq_status = 0; // Read by the IRQ handler.
+        mutable uint8_t irq_bm_status = 0;
+
+        void count_command(uint64_t ticks) const {
+            stats.busy_ticks += ticks;
+            stats.max_latency_ticks = max(stats.max_latency_ticks, ticks);
+        }
+
+    private:
+        /**
+         * Spin until the bus master is done, return its status.
+         */
+        uint8_t poll_dma() const {
+            uint64_t start = rdtsc();
+            uint8_t bm_status;
+            for (;;) {
+                bm_status = inb(bus_master_port + BM_STATUS);
+                if (!(bm_status & BM_STATUS_ACTIVE) || (bm_status & BM_STATUS_ERROR)) {
+                    break;
+                }
+
+                // The drive may abort the command without the bus master noticing.
+                uint8_t status = read_alt_status();
+                if (!(status & STATUS_BUSY) && (status & (STATUS_ERROR | STATUS_DRIVE_WRITE_FAULT))) {
+                    break;
+                }
+                pause();
+            }
+            stats.wait_ticks += rdtsc() - start;
+            return bm_status;
+        }
+
+        void sleep_until_irq() const {
+            uint64_t start = rdtsc();
+            for (;;) {
+                disable_interrupts();
+                if (__atomic_load_n(&irq_received, __ATOMIC_ACQUIRE)) {
+                    break;
+                }
+                enable_interrupts_and_halt();
+            }
+            enable_interrupts();
+
+            uint64_t ticks = rdtsc() - start;
+            stats.wait_ticks += ticks;
+            stats.sleep_ticks += ticks;
+        }
+
+        static uint8_t get_dma_command(Direction direction) {
+            return direction == Direction::READ ? BM_COMMAND_READ : 0;
+        }
+
+        /**
+         * Return the physical address of `address` if a 32-bit bus master can reach it.
+         */
+        static Option<uint32_t> translate_for_dma(paging::VirtAddr address, size_t size) {
+            auto physical = paging::translate(address);
+            if (!physical.has_value()) {
+                // Heap pages can be mapped on first touch, the transfer
+                // would touch them anyway.
+                (void)*reinterpret_cast<volatile const uint8_t*>(address);
+                physical = paging::translate(address);
+            }
+
+            if (!physical.has_value()
+                || physical.get_value() + size - 1 > frame_allocator::DMA32_MAX_ADDRESS)
+            {
+                return {};
+            }
+            return static_cast<uint32_t>(physical.get_value());
+        }
+
+        /**
+         * Describe the pages of the buffers in the PRD table, merging
+         * the physically contiguous ones. Stop when the table is full or
+         * a page can not be reached, return the number of bytes described,
+         * rounded down to whole sectors.
+         */
+        size_t build_prd_table(Span<const Span<uint8_t>> buffers, size_t skip, size_t size) const {
+            size_t count = 0;
+            size_t last_size = 0;
+            size_t described = 0;
+            bool stopped = false;
+            for (const auto& buffer : buffers) {
+                if (stopped || described == size) {
+                    break;
+                }
+                if (skip >= buffer.get_size()) {
+                    skip -= buffer.get_size();
+                    continue;
+                }
+
+                auto start = reinterpret_cast<paging::VirtAddr>(buffer.begin()) + skip;
+                size_t end = min(buffer.get_size() - skip, size - described);
+                skip = 0;
+                if (start % 2 != 0) {
+                    break;
+                }
+
+                for (size_t offset = 0; offset < end;) {
+                    paging::VirtAddr address = start + offset;
+                    size_t chunk = min(paging::PAGE_SIZE - address % paging::PAGE_SIZE, end - offset);
+                    auto physical = translate_for_dma(address, chunk);
+                    if (!physical.has_value()) {
+                        stopped = true;
+                        break;
+                    }
+
+                    uint32_t frame = physical.get_value();
+                    bool contiguous = count > 0
+                        && prd_table[count - 1].address + last_size == frame
+                        && frame % PRD_BOUNDARY != 0;
+                    if (contiguous) {
+                        last_size += chunk;
+                    } else {
+                        if (count == PRD_MAX_ENTRIES) {
+                            stopped = true;
+                            break;
+                        }
+                        prd_table[count] = { frame, 0, 0 };
+                        count++;
+                        last_size = chunk;
+                    }
+
+                    prd_table[count - 1].byte_count = static_cast<uint16_t>(last_size);
+                    offset += chunk;
+                    described += chunk;
+                }
+            }
+
+            // Drop the partial sector at the end.
+            size_t extra = described % 512;
+            while (extra > 0 && count > 0) {
+                if (last_size > extra) {
+                    last_size -= extra;
+                    prd_table[count - 1].byte_count = static_cast<uint16_t>(last_size);
+                    break;
+                }
+
+                extra -= last_size;
+                count--;
+                last_size = count > 0 ? get_entry_size(prd_table[count - 1]) : 0;
+            }
+
+            if (count == 0) {
+                return 0;
+            }
+
+            prd_table[count - 1].flags = PRD_END_OF_TABLE;
+            return described / 512 * 512;
+        }
+
+        static size_t get_entry_size(const PrdEntry& entry) {
+            return entry.byte_count == 0 ? PRD_BOUNDARY : entry.byte_count;
+        }
     };
 
     Array<Channel, 2> channels = {{
@@ -227,6 +620,392 @@ namespace ide {
         { 0x170, 0x376, 0 },
     }};
 
+    /**
+     * Requests submitted to the drives of one channel, done one
+     * command at a time. The commands are advanced from the channel's
+     * IRQ handler, or from `check` calls while interrupts are disabled.
+     *
+     * Blocking transfers claim the channel with `begin_sync`, queued
+     * commands and other blocking transfers wait until `end_sync`.
+     * Blocking transfers must not be started from completion callbacks,
+     * they can run in the IRQ handler.
+     */
+    class RequestQueue {
+    public:
+        constexpr explicit RequestQueue(const Channel& channel) : channel(channel) {}
+
+        void submit(DiskRequest& request) {
+            {
+                SpinlockGuard guard(lock);
+                if (tail) {
+                    tail->next = &request;
+                } else {
+                    head = &request;
+                }
+                tail = &request;
+
+                if (!in_flight) {
+                    start_command();
+                }
+            }
+            complete_finished();
+        }
+
+        /**
+         * Advance the command in flight if the drive is done with its current step.
+         */
+        void check() {
+            {
+                SpinlockGuard guard(lock);
+                if (in_flight && is_step_done()) {
+                    advance();
+                }
+            }
+            complete_finished();
+        }
+
+        /**
+         * Wait for the command in flight and any other blocking transfer
+         * to finish and keep the queue from starting another one.
+         */
+        void begin_sync() {
+            wait_until([this] {
+                SpinlockGuard guard(lock);
+                if (in_flight || sync_active) {
+                    return false;
+                }
+                sync_active = true;
+                return true;
+            });
+        }
+
+        void end_sync() {
+            {
+                SpinlockGuard guard(lock);
+                sync_active = false;
+                if (!in_flight) {
+                    start_command();
+                }
+            }
+            complete_finished();
+        }
+
+        /**
+         * Halt until interrupts if the channel uses them and they are enabled,
+         * poll otherwise, until `done` returns true.
+         */
+        template <typename Condition>
+        void wait_until(Condition done) {
+            uint64_t start = rdtsc();
+            for (;;) {
+                if (!channel.can_sleep()) {
+                    if (done()) {
+                        break;
+                    }
+                    check();
+                    pause();
+                    continue;
+                }
+
+                // Checked with interrupts disabled, so that the one
+                // we are waiting for can not come before `hlt`.
+                disable_interrupts();
+                if (done()) {
+                    enable_interrupts();
+                    break;
+                }
+                uint64_t sleep_start = rdtsc();
+                enable_interrupts_and_halt();
+                channel.stats.sleep_ticks += rdtsc() - sleep_start;
+
+                // Woken up by some other interrupt, the drive may be done anyway.
+                check();
+            }
+            channel.stats.wait_ticks += rdtsc() - start;
+        }
+
+    private:
+        enum class Step {
+            DMA,        // Waiting for the bus master.
+            PIO_READ,   // Waiting for the next block to read.
+            PIO_WRITE,  // Waiting for the drive to take the last block written.
+            FLUSH,      // Waiting for the cache flush after a write.
+        };
+
+        /**
+         * Call with `lock` held.
+         */
+        bool is_step_done() const {
+            channel.delay_400ns();
+            uint8_t status = channel.read_alt_status();
+            if (status & STATUS_BUSY) {
+                return false;
+            }
+            if (status & (STATUS_ERROR | STATUS_DRIVE_WRITE_FAULT)) {
+                return true;
+            }
+
+            switch (step) {
+            case Step::DMA:
+                return !channel.is_dma_active();
+            case Step::PIO_READ:
+                return status & STATUS_REQUEST_READY;
+            case Step::PIO_WRITE:
+            case Step::FLUSH:
+                return true;
+            }
+            return true;
+        }
+
+        /**
+         * Start the next command of the first request, completing requests
+         * with nothing left to do. Call with `lock` held.
+         */
+        void start_command() {
+            in_flight = false;
+            while (head && !sync_active) {
+                DiskRequest& request = *head;
+                size_t size = request.get_size();
+                if (request_done == size) {
+                    finish_request();
+                    continue;
+                }
+
+                auto& device = *static_cast<const Device*>(request.disk);
+                direction = request.write ? Direction::WRITE : Direction::READ;
+                sectors_left = min((size - request_done) / 512, device.get_max_command_sectors());
+                mode = device.get_pio_mode();
+                if (dma_enabled && device.supports_dma()) {
+                    size_t prepared = channel.prepare_dma(
+                        direction, request.buffers, request_done, sectors_left * 512);
+                    if (prepared > 0) {
+                        mode = TransferMode::DMA;
+                        sectors_left = prepared / 512;
+                    }
+                }
+                block_size = device.get_block_size(mode);
+                command_size = sectors_left * 512;
+                seek(request, request_done);
+
+                command_start = rdtsc();
+                lba48 = device.issue_command(
+                    direction, request.lba + request_done / 512, sectors_left, mode);
+                in_flight = true;
+
+                if (mode == TransferMode::DMA) {
+                    channel.start_dma(direction);
+                    step = Step::DMA;
+                    return;
+                }
+
+                if (direction == Direction::READ) {
+                    step = Step::PIO_READ;
+                    return;
+                }
+
+                // There is no interrupt before the first block.
+                if (channel.poll(true) != PollingResult::SUCCESS) {
+                    finish_command(false);
+                    continue;
+                }
+                transfer_block();
+                step = Step::PIO_WRITE;
+                return;
+            }
+        }
+
+        /**
+         * The drive is done with the current step. Call with `lock` held.
+         */
+        void advance() {
+            uint8_t status = channel.read_status(); // Acknowledges the interrupt.
+            bool failed = status & (STATUS_ERROR | STATUS_DRIVE_WRITE_FAULT);
+
+            switch (step) {
+            case Step::DMA:
+                failed |= channel.stop_dma(direction) & BM_STATUS_ERROR;
+                if (failed || direction == Direction::READ) {
+                    finish_command(!failed);
+                } else {
+                    start_flush();
+                }
+                break;
+
+            case Step::PIO_READ:
+                if (failed) {
+                    finish_command(false);
+                    break;
+                }
+                transfer_block();
+                if (sectors_left == 0) {
+                    finish_command(true);
+                }
+                break;
+
+            case Step::PIO_WRITE:
+                if (failed) {
+                    finish_command(false);
+                } else if (sectors_left > 0) {
+                    transfer_block();
+                } else {
+                    start_flush();
+                }
+                break;
+
+            case Step::FLUSH:
+                finish_command(!failed);
+                break;
+            }
+        }
+
+        void start_flush() {
+            channel.write_command(lba48 ? Command::CACHE_FLUSH_EXT : Command::CACHE_FLUSH);
+            step = Step::FLUSH;
+        }
+
+        /**
+         * Count the command and start the next one. A failed command
+         * ends its request.
+         */
+        void finish_command(bool succeeded) {
+            channel.count_command(rdtsc() - command_start);
+            if (succeeded) {
+                request_done += command_size;
+            } else {
+                finish_request();
+            }
+            start_command();
+        }
+
+        /**
+         * Move the first request to the finished list.
+         */
+        void finish_request() {
+            DiskRequest* request = head;
+            head = request->next;
+            if (!head) {
+                tail = nullptr;
+            }
+
+            request->bytes_transferred = request_done;
+            request->next = nullptr;
+            if (finished_tail) {
+                finished_tail->next = request;
+            } else {
+                finished = request;
+            }
+            finished_tail = request;
+            request_done = 0;
+        }
+
+        /**
+         * Complete the finished requests, without `lock` held:
+         * the callbacks may submit new ones.
+         */
+        void complete_finished() {
+            DiskRequest* request;
+            {
+                SpinlockGuard guard(lock);
+                request = finished;
+                finished = nullptr;
+                finished_tail = nullptr;
+            }
+
+            while (request) {
+                DiskRequest* next = request->next;
+                request->next = nullptr;
+                request->complete(request->bytes_transferred);
+                request = next;
+            }
+        }
+
+        /**
+         * Point the PIO cursor at `offset` bytes into the request.
+         */
+        void seek(const DiskRequest& request, size_t offset) {
+            buffers = request.buffers;
+            buffer_index = 0;
+            while (buffer_index < buffers.get_size() && offset >= buffers[buffer_index].get_size()) {
+                offset -= buffers[buffer_index].get_size();
+                buffer_index++;
+            }
+            buffer_offset = offset;
+        }
+
+        /**
+         * Move the next DRQ block between the drive and the buffers.
+         */
+        void transfer_block() {
+            size_t sectors = min<size_t>(block_size, sectors_left);
+            size_t size = sectors * 512;
+            while (size > 0) {
+                Span<uint8_t> buffer = buffers[buffer_index];
+                size_t chunk = min(size, buffer.get_size() - buffer_offset);
+                if (direction == Direction::READ) {
+                    insw(channel.base_port, buffer.begin() + buffer_offset, chunk / 2);
+                } else {
+                    outsw(channel.base_port, buffer.begin() + buffer_offset, chunk / 2);
+                }
+
+                size -= chunk;
+                buffer_offset += chunk;
+                if (buffer_offset == buffer.get_size()) {
+                    buffer_index++;
+                    buffer_offset = 0;
+                }
+            }
+            sectors_left -= sectors;
+        }
+
+        const Channel& channel;
+        Spinlock lock;
+
+        DiskRequest* head = nullptr; // Its commands are in flight.
+        DiskRequest* tail = nullptr;
+        DiskRequest* finished = nullptr; // To be completed outside the lock.
+        DiskRequest* finished_tail = nullptr;
+        size_t request_done = 0; // Bytes of the first request done.
+        bool sync_active = false;
+
+        // The command in flight.
+        bool in_flight = false;
+        Step step = Step::DMA;
+        Direction direction = Direction::READ;
+        TransferMode mode = TransferMode::PIO;
+        bool lba48 = false;
+        uint8_t block_size = 1;
+        size_t command_size = 0;
+        size_t sectors_left = 0; // Not yet transferred with PIO.
+        uint64_t command_start = 0;
+
+        // Where the next PIO block goes.
+        Span<const Span<uint8_t>> buffers = {};
+        size_t buffer_index = 0;
+        size_t buffer_offset = 0;
+    };
+
+    static Array<RequestQueue, 2> queues = {{
+        RequestQueue(channels[0]),
+        RequestQueue(channels[1]),
+    }};
+
+    // Legacy IRQs, the controller is used in compatibility mode.
+    constexpr Array<uint8_t, 2> CHANNEL_IRQS = {{ 14, 15 }};
+
+    __attribute__((interrupt))
+    static void primary_irq_handler(idt::InterruptFrame*) {
+        channels[0].handle_irq();
+        queues[0].check();
+        pic::send_eoi(CHANNEL_IRQS[0]);
+    }
+
+    __attribute__((interrupt))
+    static void secondary_irq_handler(idt::InterruptFrame*) {
+        channels[1].handle_irq();
+        queues[1].check();
+        pic::send_eoi(CHANNEL_IRQS[1]);
+    }
+
     IdentifyResult Device::identify() {
         Channel& channel = channels[static_cast<int>(channel_type)];
 
@@ -313,21 +1092,124 @@ namespace ide {
         }
         model[last_nonspace_index + 1] = '\0';
 
+        if (interface == InterfaceType::ATA) {
+            set_multiple_mode(get_bit_range(identification[IDENT_MAX_MULTIPLE], 0, 8));
+        }
+
         return { IdentifyResultStatus::Success, 0 };
     }
 
-    PollingResult Device::access(
+    void Device::set_multiple_mode(uint8_t max_sectors) {
+        if (max_sectors <= 1) {
+            return;
+        }
+
+        // The drive is still selected after IDENTIFY.
+        const Channel& channel = channels[static_cast<int>(channel_type)];
+        channel.write_sector_count(max_sectors);
+        channel.write_command(Command::SET_MULTIPLE_MODE);
+        if (channel.poll(false) != PollingResult::SUCCESS) {
+            LOG_WARN("Drive rejected {} sectors per block, using single-sector PIO.", max_sectors);
+            return;
+        }
+
+        multiple_sectors = max_sectors;
+    }
+
+    size_t Device::access(
         Direction direction,
         uint64_t lba,
         Span<uint8_t> buffer) const
     {
         if (interface == InterfaceType::ATAPI) {
             LOG_WARN("Attempt to access an ATAPI drive (not supported).");
-            return PollingResult::ERROR;
+            return 0;
         }
 
-        uint8_t sector_count{ static_cast<uint8_t>(
-            min(buffer.get_size() / 512, 255)) };
+        RequestQueue& queue = queues[static_cast<int>(channel_type)];
+        queue.begin_sync();
+
+        size_t size = buffer.get_size() / 512 * 512;
+        size_t done = 0;
+        while (done < size) {
+            size_t transferred = run_command(
+                direction, lba + done / 512, { buffer.begin() + done, size - done });
+            if (transferred == 0) {
+                break;
+            }
+            done += transferred;
+        }
+
+        queue.end_sync();
+        return done;
+    }
+
+    size_t Device::run_command(
+        Direction direction,
+        uint64_t lba,
+        Span<uint8_t> buffer) const
+    {
+        const Channel& channel = channels[static_cast<int>(channel_type)];
+        uint64_t start = rdtsc();
+
+        size_t sector_count = min(buffer.get_size() / 512, get_max_command_sectors());
+        TransferMode mode = get_pio_mode();
+        if (dma_enabled && supports_dma()) {
+            size_t prepared = channel.prepare_dma(direction, buffer, sector_count * 512);
+            if (prepared > 0) {
+                mode = TransferMode::DMA;
+                sector_count = prepared / 512;
+            }
+        }
+
+        channel.arm_irq();
+        bool lba48 = issue_command(direction, lba, sector_count, mode);
+
+        PollingResult result;
+        if (mode == TransferMode::DMA) {
+            result = channel.run_dma(direction);
+        } else if (direction == Direction::READ) {
+            result = channel.read_sectors(sector_count, get_block_size(mode), buffer);
+        } else {
+            result = channel.write_sectors(sector_count, get_block_size(mode), buffer);
+        }
+
+        if (result == PollingResult::SUCCESS && direction == Direction::WRITE) {
+            channel.arm_irq();
+            channel.write_command(lba48 ? Command::CACHE_FLUSH_EXT : Command::CACHE_FLUSH);
+            result = channel.wait(false);
+        }
+
+        channel.count_command(rdtsc() - start);
+        return result == PollingResult::SUCCESS ? sector_count * 512 : 0;
+    }
+
+    size_t Device::get_max_command_sectors() const {
+        return command_sets & COMMAND_SETS_USES_48_BIT ? MAX_SECTORS_LBA48 : MAX_SECTORS_LBA28;
+    }
+
+    TransferMode Device::get_pio_mode() const {
+        return multiple_enabled && multiple_sectors > 1
+            ? TransferMode::PIO_MULTIPLE
+            : TransferMode::PIO;
+    }
+
+    uint8_t Device::get_block_size(TransferMode mode) const {
+        return mode == TransferMode::PIO_MULTIPLE ? multiple_sectors : 1;
+    }
+
+    bool Device::issue_command(
+        Direction direction,
+        uint64_t lba,
+        size_t sector_count,
+        TransferMode mode) const
+    {
+        const Channel& channel = channels[static_cast<int>(channel_type)];
+        if (mode == TransferMode::DMA) {
+            channel.stats.dma_transfers++;
+        } else {
+            channel.stats.pio_transfers++;
+        }
 
         enum class AddressMode {
             CHS,
@@ -337,7 +1219,7 @@ namespace ide {
         Array<uint8_t, 6> lba_io;
         uint8_t head;
 
-        if (lba >= 0x1000'0000) {
+        if (lba + sector_count > LBA28_LIMIT || sector_count > MAX_SECTORS_LBA28) {
             address_mode = AddressMode::LBA48;
             for (int i = 0; i < 6; i++) {
                 lba_io[i] = get_bit_range(lba, i * 8, 8);
@@ -369,7 +1251,6 @@ namespace ide {
             lba_io[5] = 0;
         }
 
-        const Channel& channel = channels[static_cast<int>(channel_type)];
         channel.wait_not_busy();
 
         uint8_t drive_select_value = 0xa0;
@@ -382,45 +1263,75 @@ namespace ide {
         drive_select_value |= head;
         channel.write_drive_select(drive_select_value);
 
+        // The counts wrap around, 0 is the maximum.
         if (address_mode == AddressMode::LBA48) {
-            channel.write_sector_count(0);
+            channel.write_sector_count(get_bit_range(sector_count, 8, 8));
             channel.write_lba(lba_io[3], lba_io[4], lba_io[5]);
         }
-        channel.write_sector_count(sector_count);
+        channel.write_sector_count(get_bit_range(sector_count, 0, 8));
         channel.write_lba(lba_io[0], lba_io[1], lba_io[2]);
 
-        if (direction == Direction::READ) {
-            channel.write_command(
-                address_mode == AddressMode::LBA48
-                    ? Command::READ_PIO_EXT
-                    : Command::READ_PIO);
-            return channel.read_sectors(sector_count, buffer);
-        } else {
-            channel.write_command(
-                address_mode == AddressMode::LBA48
-                    ? Command::WRITE_PIO_EXT
-                    : Command::WRITE_PIO);
+        bool lba48 = address_mode == AddressMode::LBA48;
+        bool read = direction == Direction::READ;
+        switch (mode) {
+        case TransferMode::DMA:
+            if (read) {
+                channel.write_command(lba48 ? Command::READ_DMA_EXT : Command::READ_DMA);
+            } else {
+                channel.write_command(lba48 ? Command::WRITE_DMA_EXT : Command::WRITE_DMA);
+            }
+            break;
+        case TransferMode::PIO_MULTIPLE:
+            if (read) {
+                channel.write_command(lba48 ? Command::READ_MULTIPLE_EXT : Command::READ_MULTIPLE);
+            } else {
+                channel.write_command(lba48 ? Command::WRITE_MULTIPLE_EXT : Command::WRITE_MULTIPLE);
+            }
+            break;
+        case TransferMode::PIO:
+            if (read) {
+                channel.write_command(lba48 ? Command::READ_PIO_EXT : Command::READ_PIO);
+            } else {
+                channel.write_command(lba48 ? Command::WRITE_PIO_EXT : Command::WRITE_PIO);
+            }
+            break;
+        }
 
-            PollingResult result = channel.write_sectors(sector_count, buffer);
-            if (result != PollingResult::SUCCESS) return result;
+        return lba48;
+    }
 
-            channel.write_command(
-                address_mode == AddressMode::LBA48
-                    ? Command::CACHE_FLUSH_EXT
-                    : Command::CACHE_FLUSH);
-            return channel.poll(false);
-        }
+    size_t Device::read(uint64_t lba, Span<uint8_t> buffer) const {
+        return access(Direction::READ, lba, buffer);
     }
 
-    bool Device::read(uint64_t lba, Span<uint8_t> buffer) const {
-        return access(Direction::READ, lba, buffer) == PollingResult::SUCCESS;
+    size_t Device::write(uint64_t lba, Span<uint8_t> buffer) const {
+        return access(Direction::WRITE, lba, buffer);
     }
 
-    bool Device::write(uint64_t lba, Span<uint8_t> buffer) const {
-        access(Direction::WRITE, lba, buffer);
+    bool Device::submit(DiskRequest& request) const {
+        if (interface == InterfaceType::ATAPI) {
+            LOG_WARN("Attempt to access an ATAPI drive (not supported).");
+            return false;
+        }
+
+        if (!prepare_request(request)) {
+            return false;
+        }
+
+        queues[static_cast<int>(channel_type)].submit(request);
         return true;
     }
 
+    void Device::poll() const {
+        queues[static_cast<int>(channel_type)].check();
+    }
+
+    void Device::wait(const DiskRequest& request) const {
+        queues[static_cast<int>(channel_type)].wait_until([&] {
+            return request.is_completed();
+        });
+    }
+
     size_t Device::get_size() const {
         return size;
     }
@@ -438,6 +1349,22 @@ namespace ide {
         return { model.data, length };
     }
 
+    bool Device::supports_dma() const {
+        return features & FEATURES_SUPPORTS_DMA;
+    }
+
+    void set_dma_enabled(bool enabled) {
+        dma_enabled = enabled;
+    }
+
+    void set_multiple_enabled(bool enabled) {
+        multiple_enabled = enabled;
+    }
+
+    ChannelStats get_channel_stats(ChannelType channel) {
+        return channels[static_cast<int>(channel)].stats;
+    }
+
     static InplaceVector<ide::Device, 4> disks;
 
     Span<const ide::Device> get_disks() {
@@ -457,6 +1384,10 @@ namespace ide {
         if (bars[4]) {
             channels[0].bus_master_port = bars[4];
             channels[1].bus_master_port = bars[4] + 8;
+
+            func.enable_bus_mastering();
+            channels[0].init_dma();
+            channels[1].init_dma();
         }
 
         channels[0].disable_irqs();
@@ -487,5 +1418,17 @@ namespace ide {
                 }
             }
         }
+
+        // Drives are identified by polling, interrupts are only for transfers.
+        Array<bool, 2> has_disks = {};
+        for (const auto& disk : disks) {
+            has_disks[static_cast<int>(disk.get_channel_type())] = true;
+        }
+        if (has_disks[0]) {
+            channels[0].enable_irqs(CHANNEL_IRQS[0], primary_irq_handler);
+        }
+        if (has_disks[1]) {
+            channels[1].enable_irqs(CHANNEL_IRQS[1], secondary_irq_handler);
+        }
     }
 }
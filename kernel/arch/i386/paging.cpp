@@ -1,7 +1,15 @@
 /**
  * @file
  *
- * We assume that all page tables and directories are identity mapped.
+ * Two layouts are supported: the 32-bit one with two levels of tables,
+ * and PAE, with 64-bit entries, an NX bit and a page directory pointer
+ * table on top. PAE is used whenever the CPU has it.
+ *
+ * Page tables are reached through a recursive mapping: the last page
+ * directory entries point back to the page directories. That makes all
+ * page table entries visible as one flat array at RECURSIVE_MAP_START,
+ * indexed by page number, whatever frames the tables live in. Only
+ * `init` builds tables through the physmap, before switching to them.
  *
  * OSDev Wiki: https://wiki.osdev.org/Paging
  * Written with: https://os.phil-opp.com/paging-implementation/
@@ -11,19 +19,57 @@
 
 #include <stdint.h>
 #include <arch/i386/asm.hpp>
+#include <arch/i386/cpu.hpp>
+#include <arch/i386/tlb.hpp>
 #include <kernel/kpanic.hpp>
 #include <kernel/log.hpp>
 #include <memory/frame_allocator.hpp>
 #include <util/assert.hpp>
 #include <util/array.hpp>
+#include <util/bitmap.hpp>
 #include <util/bits.hpp>
+#include <util/math.hpp>
 #include <util/memory.hpp>
 
+/**
+ * Switch to the given tables and paging mode, defined in `boot.s`.
+ */
+extern "C" void load_page_tables(uint32_t cr3, uint32_t cr4);
+
 namespace paging {
-    class PageTable;
+    struct LegacyLayout {
+        using RawEntry = uint32_t;
+        static constexpr size_t ENTRY_COUNT = 1024;
+        static constexpr unsigned INDEX_BITS = 10;
+        static constexpr unsigned DIRECTORY_SHIFT = 22;
+        static constexpr RawEntry ADDRESS_MASK = 0xffff'f000;
+        static constexpr bool HAS_NX = false;
+
+        // The last directory entry points to the directory.
+        static constexpr VirtAddr RECURSIVE_MAP_START = 0xffc0'0000;
+    };
 
+    struct PaeLayout {
+        using RawEntry = uint64_t;
+        static constexpr size_t ENTRY_COUNT = 512;
+        static constexpr unsigned INDEX_BITS = 9;
+        static constexpr unsigned DIRECTORY_SHIFT = 21;
+        static constexpr RawEntry ADDRESS_MASK = 0x000f'ffff'ffff'f000;
+        static constexpr bool HAS_NX = true;
+
+        // The last four entries of the last directory point to the four directories.
+        static constexpr VirtAddr RECURSIVE_MAP_START = 0xff80'0000;
+    };
+
+    static bool pae_enabled = false;
+    static bool nx_enabled = false;
+    static bool large_pages_enabled = false;
+
+    template <typename Layout>
     class PageTableEntry {
     public:
+        using RawEntry = typename Layout::RawEntry;
+
         PageTableEntry() = default;
 
         PageTableEntry(const PageTableEntry& other) = delete;
@@ -35,17 +81,35 @@ namespace paging {
         ~PageTableEntry() = default;
 
         void map(PhysAddr addr, PageFlags flags) {
-            uint32_t desc = addr & 0xffff'f000;
-            desc = set_bit(desc, 0); // Present.
+            RawEntry desc = addr & Layout::ADDRESS_MASK;
+            desc = set_bit(desc, PRESENT);
             if (flags.writable) {
-                desc = set_bit(desc, 1);
+                desc = set_bit(desc, WRITABLE);
+            }
+
+            if constexpr (Layout::HAS_NX) {
+                if (nx_enabled && !flags.executable) {
+                    desc = set_bit(desc, NO_EXECUTE);
+                }
             }
 
             inner = desc;
         }
 
-        void map(const PageTable& table, PageFlags flags) {
-            map(reinterpret_cast<PhysAddr>(&table), flags);
+        /**
+         * Only for page table directory entries.
+         */
+        void map_table(PhysAddr table) {
+            map(table, PageFlags{ .writable = true, .executable = true });
+        }
+
+        /**
+         * Only for page table directory entries.
+         */
+        void map_large(PhysAddr addr, PageFlags flags) {
+            ASSERT(addr % (1u << Layout::DIRECTORY_SHIFT) == 0);
+            map(addr, flags);
+            inner = set_bit(inner, LARGE);
         }
 
         void unmap() {
@@ -54,159 +118,552 @@ namespace paging {
 
         Option<PhysAddr> get_addr() const {
             if (is_unused()) return {};
-            return inner & 0xffff'f000;
+            return inner & Layout::ADDRESS_MASK;
+        }
+
+        PageFlags get_flags() const {
+            bool no_execute = false;
+            if constexpr (Layout::HAS_NX) {
+                no_execute = get_bit(inner, NO_EXECUTE);
+            }
+
+            return PageFlags{
+                .writable = get_bit(inner, WRITABLE),
+                .executable = !no_execute,
+            };
+        }
+
+        bool is_unused() const {
+            return !get_bit(inner, PRESENT);
         }
 
         /**
          * Only for page table directory entries.
          */
-        Option<PageTable&> get_table() const {
-            if (is_unused()) return {};
-            return *reinterpret_cast<PageTable*>(inner & 0xffff'f000);
+        bool is_large() const {
+            return !is_unused() && get_bit(inner, LARGE);
         }
 
-        bool is_unused() const {
-            return !get_bit(inner, 0);
+        /**
+         * Only for page table directory entries.
+         */
+        bool has_table() const {
+            return !is_unused() && !is_large();
         }
 
     private:
-        uint32_t inner = 0;
+        static constexpr unsigned PRESENT = 0;
+        static constexpr unsigned WRITABLE = 1;
+        static constexpr unsigned LARGE = 7;
+        static constexpr unsigned NO_EXECUTE = 63;
+
+        RawEntry inner = 0;
     };
 
-    class PageTable {
-    public:
-        static Option<PageTable&> try_allocate() {
-            auto maybe = frame_allocator::allocate_frame();
-            if (!maybe.has_value()) {
-                return {};
-            }
+    template <typename Layout>
+    using PageTable = Array<PageTableEntry<Layout>, Layout::ENTRY_COUNT>;
+
+    static_assert(sizeof(PageTable<LegacyLayout>) == PAGE_SIZE);
+    static_assert(sizeof(PageTable<PaeLayout>) == PAGE_SIZE);
+
+    /**
+     * Allocate a zeroed table in the part of the physmap `boot.s`
+     * set up, used before the kernel has its own tables.
+     */
+    template <typename T>
+    static T& allocate_boot_table() {
+        auto frame = frame_allocator::allocate_contiguous(1, BOOT_MAP_END - 1);
+        if (!frame.has_value()) {
+            kpanic("Failed to allocate the initial page tables.");
+        }
+
+        void* table = to_virtual(frame.get_value());
+        memset(table, 0, PAGE_SIZE);
+        return *static_cast<T*>(table);
+    }
+
+    /**
+     * Page directory pointer table, for PAE. Its entries are loaded
+     * into the CPU along with CR3, so all four page directories are
+     * created up front and never change.
+     */
+    struct PageDirectoryPointerTable {
+        static constexpr size_t ENTRY_COUNT = 4;
 
-            PageTable* pointer = reinterpret_cast<PageTable*>(maybe.get_value());
-            new (pointer) PageTable();
-            return *pointer;
+        Array<uint64_t, ENTRY_COUNT> entries;
+    };
+
+    /**
+     * Page table operations for one layout, through the recursive mapping.
+     */
+    template <typename Layout>
+    struct Tables {
+        using Entry = PageTableEntry<Layout>;
+
+        static constexpr size_t DIRECTORY_PAGE_SIZE = 1u << Layout::DIRECTORY_SHIFT;
+        static_assert(LARGE_PAGE_SIZE % DIRECTORY_PAGE_SIZE == 0);
+
+        static constexpr VirtAddr RECURSIVE_MAP_START = Layout::RECURSIVE_MAP_START;
+        static_assert(RECURSIVE_MAP_START >= PAGE_TABLES_START);
+
+        /**
+         * All page table entries, indexed by page number.
+         */
+        static Entry* get_entries() {
+            return reinterpret_cast<Entry*>(RECURSIVE_MAP_START);
+        }
+
+        /**
+         * The page directory entries are the page table entries
+         * mapping the recursive window itself.
+         */
+        static Entry& get_directory_entry(VirtAddr address) {
+            return get_entries()[
+                RECURSIVE_MAP_START / PAGE_SIZE + (address >> Layout::DIRECTORY_SHIFT)];
+        }
+
+        /**
+         * Only valid if the directory entry has a table.
+         */
+        static Entry& get_table_entry(VirtAddr address) {
+            return get_entries()[address / PAGE_SIZE];
         }
 
-        static PageTable& get_active_page_dir() {
-            return *reinterpret_cast<PageTable*>(read_cr3());
+        /**
+         * Return the address the page table for `address` shows up at.
+         */
+        static VirtAddr get_table_address(VirtAddr address) {
+            return RECURSIVE_MAP_START + (address >> Layout::DIRECTORY_SHIFT) * PAGE_SIZE;
         }
 
-        PageTable(const PageTable& other) = delete;
-        PageTable& operator=(const PageTable& other) = delete;
+        static bool create_table(VirtAddr address) {
+            auto frame = frame_allocator::take_zeroed_frame();
+            bool zeroed = frame.has_value();
+            if (!zeroed) {
+                frame = frame_allocator::allocate_frame();
+                if (!frame.has_value()) return false;
+            }
+
+            LOG_INFO(
+                "Mapping page table for {:p}.",
+                address & ~(DIRECTORY_PAGE_SIZE - 1));
+
+            // The window may still have a translation of a large
+            // page that used to be mapped there.
+            VirtAddr table = get_table_address(address);
+            get_directory_entry(address).map_table(frame.get_value());
+            tlb::flush_page(table);
 
-        PageTable(PageTable&& other) = delete;
-        PageTable& operator=(PageTable&& other) = delete;
+            if (!zeroed) {
+                memset(reinterpret_cast<void*>(table), 0, PAGE_SIZE);
+            }
+            return true;
+        }
+
+        /**
+         * Replace a large page with a page table mapping the same frames.
+         */
+        static bool split_large_page(VirtAddr address) {
+            auto& dir_entry = get_directory_entry(address);
+
+            auto frame = frame_allocator::allocate_frame();
+            if (!frame.has_value()) return false;
+
+            // Fill the table before it replaces the large page,
+            // the code doing this may be in that page.
+            auto table = static_cast<PageTable<Layout>*>(map_temporary(frame.get_value()));
+            if (!table) {
+                frame_allocator::free_frame(frame.get_value());
+                return false;
+            }
 
-        ~PageTable() = default;
+            PhysAddr first_frame = dir_entry.get_addr().get_value();
+            PageFlags flags = dir_entry.get_flags();
+            for (size_t i = 0; i < Layout::ENTRY_COUNT; i++) {
+                (*table)[i].map(first_frame + i * PAGE_SIZE, flags);
+            }
+            unmap_temporary(table);
 
-        inline PageTableEntry& operator[](size_t index) {
-            return inner[index];
+            // The translations stay the same, only the window changes.
+            dir_entry.map_table(frame.get_value());
+            tlb::flush_page(get_table_address(address));
+            return true;
         }
 
-        inline const PageTableEntry& operator[](size_t index) const {
-            return inner[index];
+        static Option<PhysAddr> translate(VirtAddr address) {
+            auto& dir_entry = get_directory_entry(address);
+            if (dir_entry.is_large()) {
+                return dir_entry.get_addr().get_value()
+                    + get_bit_range(address, 0, Layout::DIRECTORY_SHIFT);
+            }
+
+            if (!dir_entry.has_table()) {
+                return {};
+            }
+
+            auto frame_start = get_table_entry(address).get_addr();
+            if (!frame_start.has_value()) {
+                return {};
+            }
+
+            auto offset = get_bit_range(address, 0, 12);
+            return frame_start.get_value() + offset;
         }
 
         /**
-         * Only for page table directories.
+         * Map LARGE_PAGE_SIZE bytes with directory entries, return false
+         * if that cannot be done.
          */
-        void use() {
-            write_cr3(reinterpret_cast<uint32_t>(this));
+        static bool try_map_large(VirtAddr page, PhysAddr frame, PageFlags flags) {
+            if (!large_pages_enabled
+                || page % LARGE_PAGE_SIZE != 0
+                || frame % LARGE_PAGE_SIZE != 0)
+            {
+                return false;
+            }
+
+            // Only take over directory entries that are not in use,
+            // existing page tables may have other mappings.
+            for (size_t offset = 0; offset < LARGE_PAGE_SIZE; offset += DIRECTORY_PAGE_SIZE) {
+                if (get_directory_entry(page + offset).has_table()) {
+                    return false;
+                }
+            }
+
+            for (size_t offset = 0; offset < LARGE_PAGE_SIZE; offset += DIRECTORY_PAGE_SIZE) {
+                auto& dir_entry = get_directory_entry(page + offset);
+                bool was_mapped = !dir_entry.is_unused();
+                if (was_mapped) {
+                    LOG_WARN("Mapping large page {:p} that is already mapped to {:p}.",
+                        page + offset, dir_entry.get_addr().get_value());
+                }
+
+                dir_entry.map_large(frame + offset, flags);
+                if (was_mapped) {
+                    tlb::flush_page(page + offset);
+                }
+            }
+            return true;
         }
 
-    private:
-        PageTable() {
-            ASSERT(reinterpret_cast<size_t>(this) % PAGE_SIZE == 0);
+        static bool map(VirtAddr page, PhysAddr frame, PageFlags flags) {
+            auto& dir_entry = get_directory_entry(page);
+            if (dir_entry.is_large()) {
+                if (!split_large_page(page)) return false;
+            } else if (dir_entry.is_unused()) {
+                if (!create_table(page)) return false;
+            }
+
+            auto& entry = get_table_entry(page);
+            bool was_mapped = !entry.is_unused();
+            if (was_mapped) {
+                LOG_WARN("Mapping page {:p} that is already mapped to {:p}.",
+                    page & ~(PAGE_SIZE - 1), entry.get_addr().get_value());
+            }
+
+            entry.map(frame, flags);
+            if (was_mapped) {
+                tlb::flush_page(page);
+            }
+            return true;
+        }
+
+        static void unmap(VirtAddr page) {
+            auto& dir_entry = get_directory_entry(page);
+            if (dir_entry.is_large()) {
+                if (!split_large_page(page)) {
+                    kpanic("Failed to split the large page containing {:p}.", page);
+                }
+            }
+
+            if (!dir_entry.has_table()) {
+                return;
+            }
+
+            auto& entry = get_table_entry(page);
+            if (entry.is_unused()) {
+                return;
+            }
+
+            entry.unmap();
+            tlb::flush_page(page);
+        }
+
+        static void unmap_large(VirtAddr page) {
+            ASSERT(page % LARGE_PAGE_SIZE == 0);
+
+            for (size_t offset = 0; offset < LARGE_PAGE_SIZE; offset += DIRECTORY_PAGE_SIZE) {
+                auto& dir_entry = get_directory_entry(page + offset);
+                ASSERT(dir_entry.is_large());
+
+                dir_entry.unmap();
+                tlb::flush_page(page + offset);
+            }
         }
 
-        Array<PageTableEntry, 1024> inner;
+        static bool is_large_page(VirtAddr address) {
+            return get_directory_entry(address).is_large();
+        }
+
+        /**
+         * Clear the directory entries covering [start, end), leaving
+         * the page tables alone, they may be used by other entries.
+         */
+        static void unmap_directory_entries(VirtAddr start, VirtAddr end) {
+            for (VirtAddr addr = start; addr < end; addr += DIRECTORY_PAGE_SIZE) {
+                get_directory_entry(addr).unmap();
+            }
+            tlb::flush_all();
+        }
     };
 
-    static void enable_paging() {
-        asm volatile(
-            "mov %cr0, %eax\n\t"
-            "or $0x80000000, %eax\n\t"
-            "mov %eax, %cr0");
+    PhysAddr get_max_address() {
+        unsigned bits = cpu::has_feature(cpu::Feature::PAE)
+            ? cpu::get_physical_address_bits()
+            : 32;
+        return (PhysAddr(1) << bits) - 1;
     }
 
-    void init() {
-        auto maybe_page_dir = PageTable::try_allocate();
-        if (!maybe_page_dir.has_value()) {
-            kpanic("Failed to allocate the first page table directory.");
-        }
+    bool is_pae_enabled() {
+        return pae_enabled;
+    }
+
+    bool supports_large_pages() {
+        return large_pages_enabled;
+    }
 
-        auto& page_directory = maybe_page_dir.get_value();
-        page_directory.use();
+    /**
+     * The kernel's tables map the same memory `boot.s` does: the
+     * first BOOT_MAP_END bytes at KERNEL_BASE, and identity mapped
+     * for `load_page_tables`, until `init` removes that.
+     */
+    static constexpr PageFlags BOOT_MAP_FLAGS{ .writable = true, .executable = true };
+
+    static void init_legacy() {
+        using Entry = PageTableEntry<LegacyLayout>;
+        auto& directory = allocate_boot_table<PageTable<LegacyLayout>>();
+
+        uint32_t cr4 = read_cr4();
+        if (cpu::has_feature(cpu::Feature::PSE)) {
+            cr4 = set_bit(cr4, 4);
+            large_pages_enabled = true;
+        } else {
+            LOG_INFO("PSE is not supported, using 4KiB pages only.");
+        }
 
-        // Identity map the first 4MiB.
-        for (int i = 0; i < 1024; i++) {
-            map(i * 0x1000, i * 0x1000, PageFlags{ .writable = true });
+        static_assert(BOOT_MAP_END == LARGE_PAGE_SIZE);
+        Entry& identity_entry = directory[0];
+        Entry& kernel_entry = directory[KERNEL_BASE >> LegacyLayout::DIRECTORY_SHIFT];
+        if (large_pages_enabled) {
+            identity_entry.map_large(0, BOOT_MAP_FLAGS);
+            kernel_entry.map_large(0, BOOT_MAP_FLAGS);
+        } else {
+            auto& table = allocate_boot_table<PageTable<LegacyLayout>>();
+            for (size_t i = 0; i < table.get_size(); i++) {
+                table[i].map(i * PAGE_SIZE, BOOT_MAP_FLAGS);
+            }
+            identity_entry.map_table(to_physical(&table));
+            kernel_entry.map_table(to_physical(&table));
         }
 
-        enable_paging();
+        Entry& recursive_entry = directory[
+            LegacyLayout::RECURSIVE_MAP_START >> LegacyLayout::DIRECTORY_SHIFT];
+        recursive_entry.map(to_physical(&directory), PageFlags{ .writable = true });
+
+        load_page_tables(to_physical(&directory), cr4);
     }
 
-    Option<PhysAddr> translate(VirtAddr address) {
-        auto& page_directory = PageTable::get_active_page_dir();
+    static void init_pae() {
+        using Entry = PageTableEntry<PaeLayout>;
+
+        // A whole frame, the table only has to be 32-byte aligned.
+        auto& pdpt = allocate_boot_table<PageDirectoryPointerTable>();
+        Array<PageTable<PaeLayout>*, PageDirectoryPointerTable::ENTRY_COUNT> directories;
+        for (size_t i = 0; i < pdpt.entries.get_size(); i++) {
+            directories[i] = &allocate_boot_table<PageTable<PaeLayout>>();
+
+            // Only the present bit, the others are reserved.
+            pdpt.entries[i] = to_physical(directories[i]) | 1;
+        }
+
+        auto get_entry = [&](VirtAddr address) -> Entry& {
+            auto& directory = *directories[address >> 30];
+            return directory[get_bit_range(
+                address, PaeLayout::DIRECTORY_SHIFT, PaeLayout::INDEX_BITS)];
+        };
+
+        uint32_t cr4 = set_bit(read_cr4(), 5);
+        pae_enabled = true;
+        large_pages_enabled = true;
 
-        auto dir_index = get_bit_range(address, 22, 10);
-        auto page_table = page_directory[dir_index].get_table();
-        if (!page_table.has_value()) {
-            return {};
+        if (cpu::has_feature(cpu::Feature::NX)) {
+            constexpr uint32_t EFER = 0xc000'0080;
+            wrmsr(EFER, set_bit(rdmsr(EFER), 11));
+            nx_enabled = true;
         }
 
-        auto table_index = get_bit_range(address, 12, 10);
-        auto frame_start = page_table.get_value()[table_index].get_addr();
-        if (!frame_start.has_value()) {
-            return {};
+        constexpr size_t DIRECTORY_PAGE_SIZE = Tables<PaeLayout>::DIRECTORY_PAGE_SIZE;
+        for (PhysAddr addr = 0; addr < BOOT_MAP_END; addr += DIRECTORY_PAGE_SIZE) {
+            get_entry(addr).map_large(addr, BOOT_MAP_FLAGS);
+            get_entry(KERNEL_BASE + addr).map_large(addr, BOOT_MAP_FLAGS);
         }
 
-        auto offset = get_bit_range(address, 0, 12);
-        return frame_start.get_value() + offset;
+        // The recursive window is at the end of the last directory.
+        for (size_t i = 0; i < directories.get_size(); i++) {
+            get_entry(PaeLayout::RECURSIVE_MAP_START + i * DIRECTORY_PAGE_SIZE).map(
+                to_physical(directories[i]),
+                PageFlags{ .writable = true });
+        }
+
+        load_page_tables(to_physical(&pdpt), cr4);
     }
 
-    bool map(VirtAddr page, PhysAddr frame, PageFlags flags) {
-        auto& page_directory = PageTable::get_active_page_dir();
+    static Array<uint32_t, Bitmap::get_storage_size(TEMPORARY_MAP_SLOTS)> temporary_slot_storage;
+
+    /**
+     * Set bits are free slots.
+     */
+    static Bitmap temporary_slots;
+
+    /**
+     * Map the physical memory above the boot mapping into the physmap.
+     */
+    static void map_physmap() {
+        PhysAddr end = min(frame_allocator::get_memory_end(), PHYSMAP_SIZE);
+        for (PhysAddr addr = BOOT_MAP_END; addr < end; addr += LARGE_PAGE_SIZE) {
+            if (!map(KERNEL_BASE + addr, addr, PageFlags{ .writable = true, .large = true })) {
+                kpanic("Failed to map physical memory at {:p}.", addr);
+            }
+        }
+    }
 
-        auto dir_index = get_bit_range(page, 22, 10);
-        auto page_table = page_directory[dir_index].get_table();
-        if (!page_table.has_value()) {
-            LOG_INFO(
-                "Mapping page table {}.",
-                dir_index);
+    void init() {
+        if (cpu::has_feature(cpu::Feature::PAE)) {
+            init_pae();
+        } else {
+            init_legacy();
+        }
+
+        LOG_INFO("Paging: {}, large pages: {}, NX: {}",
+            pae_enabled ? "PAE" : "32-bit",
+            large_pages_enabled ? "yes" : "no",
+            nx_enabled ? "yes" : "no");
+
+        // Nothing runs from the identity mapping anymore,
+        // the lower part of the address space is left empty.
+        if (pae_enabled) {
+            Tables<PaeLayout>::unmap_directory_entries(0, BOOT_MAP_END);
+        } else {
+            Tables<LegacyLayout>::unmap_directory_entries(0, BOOT_MAP_END);
+        }
 
-            page_table = PageTable::try_allocate();
-            if (!page_table.has_value()) return false;
+        temporary_slots = Bitmap(
+            { temporary_slot_storage.begin(), temporary_slot_storage.get_size() },
+            TEMPORARY_MAP_SLOTS);
+        for (size_t i = 0; i < TEMPORARY_MAP_SLOTS; i++) {
+            temporary_slots.set(i);
+        }
 
-            page_directory[dir_index]
-                .map(page_table.get_value(), PageFlags{ .writable = true });
+        map_physmap();
+    }
+
+    Option<PhysAddr> translate(VirtAddr address) {
+        if (pae_enabled) {
+            return Tables<PaeLayout>::translate(address);
         }
+        return Tables<LegacyLayout>::translate(address);
+    }
 
-        auto table_index = get_bit_range(page, 12, 10);
-        auto& entry = page_table.get_value()[table_index];
-        if (!entry.is_unused()) {
-            LOG_WARN("Mapping page {:p} that is already mapped to {:p}.",
-                page & 0xffff'f000, entry.get_addr().get_value());
+    bool map(VirtAddr page, PhysAddr frame, PageFlags flags) {
+        ASSERT(page < PAGE_TABLES_START);
+
+        if (flags.large) {
+            bool mapped = pae_enabled
+                ? Tables<PaeLayout>::try_map_large(page, frame, flags)
+                : Tables<LegacyLayout>::try_map_large(page, frame, flags);
+            if (mapped) {
+                return true;
+            }
+
+            PageFlags small_flags = flags;
+            small_flags.large = false;
+            for (size_t offset = 0; offset < LARGE_PAGE_SIZE; offset += PAGE_SIZE) {
+                if (!map(page + offset, frame + offset, small_flags)) {
+                    return false;
+                }
+            }
+            return true;
         }
 
-        entry.map(frame, flags);
-        return true;
+        if (pae_enabled) {
+            return Tables<PaeLayout>::map(page, frame, flags);
+        }
+        return Tables<LegacyLayout>::map(page, frame, flags);
     }
 
     void unmap(VirtAddr page) {
-        auto& page_directory = PageTable::get_active_page_dir();
+        ASSERT(page < PAGE_TABLES_START);
+
+        if (pae_enabled) {
+            Tables<PaeLayout>::unmap(page);
+        } else {
+            Tables<LegacyLayout>::unmap(page);
+        }
+    }
+
+    void unmap_large(VirtAddr page) {
+        ASSERT(page < PAGE_TABLES_START);
 
-        auto dir_index = get_bit_range(page, 22, 10);
-        auto page_table = page_directory[dir_index].get_table();
-        if (!page_table.has_value()) {
-            return;
+        if (pae_enabled) {
+            Tables<PaeLayout>::unmap_large(page);
+        } else {
+            Tables<LegacyLayout>::unmap_large(page);
         }
+    }
 
-        auto table_index = get_bit_range(page, 12, 10);
-        auto& entry = page_table.get_value()[table_index];
-        entry.unmap();
+    bool is_large_page(VirtAddr address) {
+        if (pae_enabled) {
+            return Tables<PaeLayout>::is_large_page(address);
+        }
+        return Tables<LegacyLayout>::is_large_page(address);
     }
 
     bool is_mapped(VirtAddr address) {
         return translate(address).has_value();
     }
+
+    void* map_temporary(PhysAddr frame) {
+        uint32_t flags = save_and_disable_interrupts();
+        auto slot = temporary_slots.find_first_set();
+        if (slot.has_value()) {
+            temporary_slots.clear(slot.get_value());
+        }
+        restore_interrupts(flags);
+
+        if (!slot.has_value()) {
+            LOG_ERROR("No free temporary mapping slots.");
+            return nullptr;
+        }
+
+        VirtAddr page = TEMPORARY_MAP_START + slot.get_value() * PAGE_SIZE;
+        if (!map(page, frame & ~PhysAddr(PAGE_SIZE - 1), PageFlags{ .writable = true })) {
+            unmap_temporary(reinterpret_cast<void*>(page));
+            return nullptr;
+        }
+
+        return reinterpret_cast<void*>(page);
+    }
+
+    void unmap_temporary(void* page) {
+        auto addr = reinterpret_cast<VirtAddr>(page);
+        ASSERT(addr >= TEMPORARY_MAP_START);
+        size_t slot = (addr - TEMPORARY_MAP_START) / PAGE_SIZE;
+        ASSERT(slot < TEMPORARY_MAP_SLOTS);
+
+        unmap(addr);
+
+        uint32_t flags = save_and_disable_interrupts();
+        temporary_slots.set(slot);
+        restore_interrupts(flags);
+    }
 }
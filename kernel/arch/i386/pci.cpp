@@ -31,6 +31,29 @@ namespace pci {
         return inl(CONFIG_DATA_PORT);
     }
 
+    /**
+     * bus      - 8 bits available (up to 0xff).
+     * device   - 5 bits available (up to 0x20).
+     * function - 3 bits available (up to 0x08).
+     * offset   - 8 bits available (up to 0xff),
+     *            has to be aligned to 4 bytes.
+     */
+    static void config_write_u32(
+        uint8_t bus, uint8_t device,
+        uint8_t function, uint8_t offset,
+        uint32_t value)
+    {
+        uint32_t address =
+            0x80000000 |
+            (bus << 16) |
+            (device << 11) |
+            (function << 8) |
+            offset;
+
+        outl(CONFIG_ADDRESS_PORT, address);
+        outl(CONFIG_DATA_PORT, value);
+    }
+
     /**
      * bus      - 8 bits available (up to 0xff).
      * device   - 5 bits available (up to 0x20).
@@ -113,6 +136,12 @@ namespace pci {
         return get_bit(config_read_u8(bus, device, function, 0x0e), 7);
     }
 
+    void Function::enable_bus_mastering() const {
+        // The status register above the command one is cleared by writing ones.
+        uint32_t command = config_read_u32(bus, device, function, 0x04) & 0xffff;
+        config_write_u32(bus, device, function, 0x04, set_bit(command, 2));
+    }
+
     /**
      * Read I/O port written in a Base Address Regiter.
      * If the BAR contains a memory address, the returned value is undefined.
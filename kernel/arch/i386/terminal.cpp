@@ -2,9 +2,12 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <arch/i386/paging.hpp>
+#include <util/memory.hpp>
 
 namespace terminal {
-    static uint16_t* const BUFFER = reinterpret_cast<uint16_t*>(0xb8000);
+    static uint16_t* const BUFFER =
+        reinterpret_cast<uint16_t*>(paging::KERNEL_BASE + 0xb8000);
 
     static constexpr inline uint8_t vga_entry_color(Color fg, Color bg) {
         return static_cast<uint8_t>(fg) | static_cast<uint8_t>(bg) << 4;
@@ -24,11 +27,9 @@ namespace terminal {
 
     static void next_line() {
         if (row == HEIGHT - 1) {
-            for (size_t y = 0; y < HEIGHT - 1; y++) {
-                for (size_t x = 0; x < WIDTH; x++) {
-                    buffer_entry(x, y) = buffer_entry(x, y + 1);
-                }
-            }
+            memmove(
+                &buffer_entry(0, 0), &buffer_entry(0, 1),
+                (HEIGHT - 1) * WIDTH * sizeof(uint16_t));
 
             for (size_t x = 0; x < WIDTH; x++) {
                 put_entry_at(' ',
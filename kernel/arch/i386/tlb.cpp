@@ -0,0 +1,96 @@
+#include <arch/i386/tlb.hpp>
+
+#include <arch/i386/asm.hpp>
+#include <util/array.hpp>
+#include <util/assert.hpp>
+
+namespace tlb {
+    /**
+     * Pages waiting for the end of the batch.
+     */
+    struct PendingFlush {
+        Array<paging::VirtAddr, FLUSH_ALL_THRESHOLD> pages;
+        size_t page_count;
+        bool flush_all;
+    };
+
+    static size_t batch_depth = 0;
+    static PendingFlush pending;
+    static Stats stats;
+
+    static void invalidate(paging::VirtAddr page) {
+        invlpg(page);
+        stats.page_flushes++;
+    }
+
+    void flush_page(paging::VirtAddr page) {
+        if (batch_depth == 0) {
+            invalidate(page);
+            return;
+        }
+
+        if (pending.flush_all) {
+            return;
+        }
+
+        if (pending.page_count == FLUSH_ALL_THRESHOLD) {
+            pending.flush_all = true;
+            return;
+        }
+
+        pending.pages[pending.page_count] = page;
+        pending.page_count++;
+    }
+
+    void flush_range(paging::VirtAddr start, size_t page_count) {
+        if (page_count > FLUSH_ALL_THRESHOLD) {
+            flush_all();
+            return;
+        }
+
+        for (size_t i = 0; i < page_count; i++) {
+            flush_page(start + i * paging::PAGE_SIZE);
+        }
+    }
+
+    void flush_all() {
+        if (batch_depth > 0) {
+            pending.flush_all = true;
+            return;
+        }
+
+        write_cr3(read_cr3());
+        stats.full_flushes++;
+    }
+
+    void begin_batch() {
+        uint32_t flags = save_and_disable_interrupts();
+        batch_depth++;
+        restore_interrupts(flags);
+    }
+
+    void end_batch() {
+        uint32_t flags = save_and_disable_interrupts();
+        ASSERT(batch_depth > 0);
+        batch_depth--;
+
+        if (batch_depth == 0) {
+            if (pending.flush_all) {
+                flush_all();
+            } else {
+                for (size_t i = 0; i < pending.page_count; i++) {
+                    invalidate(pending.pages[i]);
+                }
+            }
+
+            pending.page_count = 0;
+            pending.flush_all = false;
+        }
+
+        restore_interrupts(flags);
+    }
+
+    Stats get_stats() {
+        return stats;
+    }
+}
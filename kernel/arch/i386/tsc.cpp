@@ -0,0 +1,67 @@
+#include <arch/i386/tsc.hpp>
+
+#include <arch/i386/asm.hpp>
+#include <kernel/log.hpp>
+
+namespace tsc {
+    constexpr uint16_t PIT_CHANNEL2_DATA = 0x42;
+    constexpr uint16_t PIT_COMMAND = 0x43;
+    constexpr uint16_t SPEAKER_PORT = 0x61;
+
+    constexpr uint32_t PIT_FREQUENCY = 1'193'182;
+    constexpr uint32_t CALIBRATION_MS = 10;
+
+    static uint64_t frequency_khz = 0;
+
+    /**
+     * Run PIT channel 2 for CALIBRATION_MS in one-shot mode
+     * and count the TSC ticks until it runs out.
+     */
+    static uint64_t measure_ticks() {
+        constexpr uint16_t count = PIT_FREQUENCY * CALIBRATION_MS / 1000;
+
+        // Enable the channel 2 gate, keep the speaker off.
+        uint8_t speaker = inb(SPEAKER_PORT);
+        outb(SPEAKER_PORT, (speaker & ~0x02) | 0x01);
+
+        // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count).
+        outb(PIT_COMMAND, 0b1011'0000);
+        outb(PIT_CHANNEL2_DATA, count & 0xff);
+        outb(PIT_CHANNEL2_DATA, count >> 8);
+
+        // Restart the count by toggling the gate.
+        speaker = inb(SPEAKER_PORT);
+        outb(SPEAKER_PORT, speaker & ~0x01);
+        outb(SPEAKER_PORT, speaker | 0x01);
+
+        uint64_t start = rdtsc();
+        while ((inb(SPEAKER_PORT) & 0x20) == 0) {}
+        uint64_t end = rdtsc();
+
+        return end - start;
+    }
+
+    void calibrate() {
+        // Take the fastest of several runs, the others were interrupted
+        // by something (an SMI or the emulator being descheduled).
+        uint64_t best = UINT64_MAX;
+        for (int i = 0; i < 5; i++) {
+            uint64_t ticks = measure_ticks();
+            if (ticks < best) best = ticks;
+        }
+
+        frequency_khz = best / CALIBRATION_MS;
+        LOG_INFO("TSC frequency: {} kHz", frequency_khz);
+    }
+
+    uint64_t get_frequency_khz() {
+        return frequency_khz;
+    }
+
+    uint64_t to_nanoseconds(uint64_t ticks) {
+        if (frequency_khz == 0) {
+            return 0;
+        }
+        return ticks * 1'000'000 / frequency_khz;
+    }
+}
@@ -0,0 +1,62 @@
+#include <bench/bench.hpp>
+
+#include <arch/i386/tsc.hpp>
+#include <kernel/print.hpp>
+#include <memory/kmalloc.hpp>
+#include <memory/memory_report.hpp>
+#include <util/math.hpp>
+
+namespace bench {
+    void report(StringView name, size_t iterations, uint64_t ticks) {
+        uint64_t ticks_per_iteration = ticks / iterations;
+        println("  {}: {} ticks/op, {} ns/op",
+            name, ticks_per_iteration,
+            tsc::to_nanoseconds(ticks) / iterations);
+    }
+
+    void report_throughput(StringView name, size_t size, uint64_t bytes, uint64_t ticks) {
+        // Bytes per nanosecond are GB/s.
+        uint64_t nanoseconds = max(tsc::to_nanoseconds(ticks), 1);
+        println("  {} ({} bytes): {} MB/s",
+            name, size, bytes * 1000 / nanoseconds);
+    }
+
+    size_t count_allocations() {
+        size_t count = kmalloc_get_stats().large_allocations;
+        for (size_t i = 0; i < kmalloc_get_class_count(); i++) {
+            count += kmalloc_get_class_stats(i).allocations;
+        }
+        return count;
+    }
+
+    void run_all() {
+        uint32_t flags = save_and_disable_interrupts();
+        tsc::calibrate();
+
+        println("Heap:");
+        run_heap_benchmarks();
+
+        println("Object cache:");
+        run_object_cache_benchmarks();
+
+        println("Memory functions:");
+        run_memory_benchmarks();
+
+        println("Strings:");
+        run_string_benchmarks();
+
+        println("Vectors:");
+        run_vector_benchmarks();
+
+        println("Bounds checks:");
+        run_bounds_benchmarks();
+
+        println("Disk:");
+        run_disk_benchmarks();
+
+        // Everything the benchmarks allocated should be back by now.
+        memory_report::print();
+
+        restore_interrupts(flags);
+    }
+}
@@ -0,0 +1,90 @@
+#include <bench/bench.hpp>
+
+#include <kernel/print.hpp>
+#include <util/array.hpp>
+#include <util/bits.hpp>
+#include <util/byte_buffer.hpp>
+#include <util/span.hpp>
+
+namespace bench {
+    static constexpr size_t SECTOR_COUNT = 128;
+    static constexpr size_t BUFFER_SIZE = SECTOR_COUNT * 512;
+    static constexpr size_t ROUNDS = 20;
+
+    static Array<uint16_t, BUFFER_SIZE / 2> words;
+
+    /**
+     * Split words into bytes the way the IDE driver did
+     * for PIO transfers before it used `rep insw`.
+     */
+    static void bench_unpack_checked(Span<uint8_t> buffer) {
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            size_t bytes_read = 0;
+            for (auto word : words) {
+                buffer[bytes_read] = get_bit_range(word, 0, 8);
+                buffer[bytes_read + 1] = get_bit_range(word, 8, 8);
+                bytes_read += 2;
+            }
+            do_not_optimize(buffer.begin());
+        }
+        report_throughput("unpack words, operator[]", BUFFER_SIZE,
+            ROUNDS * BUFFER_SIZE, stopwatch.get_elapsed_ticks());
+    }
+
+    static void bench_unpack_unchecked(Span<uint8_t> buffer) {
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            ASSERT(buffer.get_size() >= BUFFER_SIZE);
+            size_t bytes_read = 0;
+            for (auto word : words) {
+                buffer.unchecked_at(bytes_read) = get_bit_range(word, 0, 8);
+                buffer.unchecked_at(bytes_read + 1) = get_bit_range(word, 8, 8);
+                bytes_read += 2;
+            }
+            do_not_optimize(buffer.begin());
+        }
+        report_throughput("unpack words, unchecked_at", BUFFER_SIZE,
+            ROUNDS * BUFFER_SIZE, stopwatch.get_elapsed_ticks());
+    }
+
+    static void bench_sum_checked(Span<const uint8_t> buffer) {
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            uint32_t sum = 0;
+            for (size_t i = 0; i < buffer.get_size(); i++) {
+                sum += buffer[i];
+            }
+            do_not_optimize(sum);
+        }
+        report_throughput("sum bytes, operator[]", BUFFER_SIZE,
+            ROUNDS * BUFFER_SIZE, stopwatch.get_elapsed_ticks());
+    }
+
+    static void bench_sum_unchecked(Span<const uint8_t> buffer) {
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            uint32_t sum = 0;
+            for (size_t i = 0; i < buffer.get_size(); i++) {
+                sum += buffer.unchecked_at(i);
+            }
+            do_not_optimize(sum);
+        }
+        report_throughput("sum bytes, unchecked_at", BUFFER_SIZE,
+            ROUNDS * BUFFER_SIZE, stopwatch.get_elapsed_ticks());
+    }
+
+    void run_bounds_benchmarks() {
+        println("  Bounds checks are {} in this build.", BOUNDS_CHECKS ? "on" : "off");
+
+        for (size_t i = 0; i < words.get_size(); i++) {
+            words[i] = i * 0x9e37;
+        }
+
+        ByteBuffer buffer(BUFFER_SIZE);
+        bench_unpack_checked(buffer);
+        bench_unpack_unchecked(buffer);
+        bench_sum_checked(buffer);
+        bench_sum_unchecked(buffer);
+    }
+}
@@ -0,0 +1,232 @@
+#include <bench/bench.hpp>
+
+#include <arch/i386/ide.hpp>
+#include <arch/i386/tsc.hpp>
+#include <kernel/print.hpp>
+#include <util/array.hpp>
+#include <util/byte_buffer.hpp>
+#include <util/inplace_vector.hpp>
+#include <util/math.hpp>
+#include <util/vector.hpp>
+
+namespace bench {
+    static constexpr size_t SECTOR_SIZE = 512;
+    static constexpr size_t SEQUENTIAL_SIZE = 64 * 1024;
+    static constexpr size_t SEQUENTIAL_TOTAL = 16 * 1024 * 1024;
+    static constexpr size_t RANDOM_SIZE = 4 * 1024;
+    static constexpr size_t RANDOM_READS = 256;
+    static constexpr size_t QUEUE_DEPTH = 8;
+
+    static ide::ChannelStats get_stats(const ide::Device& disk) {
+        return ide::get_channel_stats(disk.get_channel_type());
+    }
+
+    /**
+     * Add up the stats of both channels.
+     */
+    static ide::ChannelStats get_total_stats() {
+        auto primary = ide::get_channel_stats(ide::ChannelType::PRIMARY);
+        auto secondary = ide::get_channel_stats(ide::ChannelType::SECONDARY);
+        return {
+            .dma_transfers = primary.dma_transfers + secondary.dma_transfers,
+            .pio_transfers = primary.pio_transfers + secondary.pio_transfers,
+            .irqs = primary.irqs + secondary.irqs,
+            .busy_ticks = primary.busy_ticks + secondary.busy_ticks,
+            .max_latency_ticks = max(primary.max_latency_ticks, secondary.max_latency_ticks),
+            .wait_ticks = primary.wait_ticks + secondary.wait_ticks,
+            .sleep_ticks = primary.sleep_ticks + secondary.sleep_ticks,
+        };
+    }
+
+    /**
+     * Print the throughput, the share of the time the CPU was not
+     * halted waiting for an IRQ and the average command latency.
+     */
+    static void report_disk(
+        StringView name, size_t size, uint64_t bytes, uint64_t ticks,
+        const ide::ChannelStats& before, const ide::ChannelStats& after)
+    {
+        report_throughput(name, size, bytes, ticks);
+
+        uint64_t sleep_ticks = after.sleep_ticks - before.sleep_ticks;
+        uint64_t cpu_ticks = ticks - min(sleep_ticks, ticks);
+        size_t commands = after.dma_transfers + after.pio_transfers
+            - before.dma_transfers - before.pio_transfers;
+        uint64_t latency = (after.busy_ticks - before.busy_ticks) / max(commands, 1);
+        println("    CPU busy {}%, {} IRQs, {} us per command",
+            cpu_ticks * 100 / max(ticks, 1), after.irqs - before.irqs,
+            tsc::to_nanoseconds(latency) / 1000);
+    }
+
+    static void bench_sequential(const ide::Device& disk, Span<uint8_t> buffer, StringView name) {
+        size_t sectors_per_read = SEQUENTIAL_SIZE / SECTOR_SIZE;
+        size_t reads = min(SEQUENTIAL_TOTAL / SEQUENTIAL_SIZE, disk.get_size() / sectors_per_read);
+
+        ide::ChannelStats before = get_stats(disk);
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < reads; i++) {
+            if (disk.read(i * sectors_per_read, { buffer.begin(), SEQUENTIAL_SIZE }) != SEQUENTIAL_SIZE) {
+                println("  {}: read failed", name);
+                return;
+            }
+        }
+        uint64_t ticks = stopwatch.get_elapsed_ticks();
+
+        report_disk(name, SEQUENTIAL_SIZE, reads * SEQUENTIAL_SIZE,
+            ticks, before, get_stats(disk));
+    }
+
+    static void bench_random(const ide::Device& disk, Span<uint8_t> buffer, StringView name) {
+        size_t sectors_per_read = RANDOM_SIZE / SECTOR_SIZE;
+        size_t slots = disk.get_size() / sectors_per_read;
+        uint32_t random = 0x1234'5678;
+
+        ide::ChannelStats before = get_stats(disk);
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < RANDOM_READS; i++) {
+            uint64_t lba = next_random(random) % slots * sectors_per_read;
+            if (disk.read(lba, { buffer.begin(), RANDOM_SIZE }) != RANDOM_SIZE) {
+                println("  {}: read failed", name);
+                return;
+            }
+        }
+        uint64_t ticks = stopwatch.get_elapsed_ticks();
+
+        report_disk(name, RANDOM_SIZE, RANDOM_READS * RANDOM_SIZE,
+            ticks, before, get_stats(disk));
+    }
+
+    /**
+     * A read of SEQUENTIAL_SIZE bytes into two separate halves.
+     */
+    struct QueuedRead {
+        DiskRequest request;
+        Array<Span<uint8_t>, 2> buffers;
+    };
+
+    static void count_completion(DiskRequest& request) {
+        (*static_cast<size_t*>(request.context))++;
+    }
+
+    /**
+     * Keep QUEUE_DEPTH reads in flight on each of `disks` at once,
+     * waiting for a whole batch before submitting the next one.
+     */
+    static void bench_queued(Span<const ide::Device* const> disks, StringView name) {
+        size_t sectors_per_read = SEQUENTIAL_SIZE / SECTOR_SIZE;
+        size_t batches = SEQUENTIAL_TOTAL / SEQUENTIAL_SIZE / QUEUE_DEPTH;
+        for (auto disk : disks) {
+            batches = min(batches, disk->get_size() / sectors_per_read / QUEUE_DEPTH);
+        }
+
+        size_t read_count = disks.get_size() * QUEUE_DEPTH;
+        ByteBuffer memory(read_count * SEQUENTIAL_SIZE);
+        Vector<QueuedRead> reads(read_count);
+        reads.resize(read_count);
+        for (size_t i = 0; i < read_count; i++) {
+            uint8_t* start = memory.begin() + i * SEQUENTIAL_SIZE;
+            reads[i].buffers[0] = { start, SEQUENTIAL_SIZE / 2 };
+            reads[i].buffers[1] = { start + SEQUENTIAL_SIZE / 2, SEQUENTIAL_SIZE / 2 };
+        }
+
+        size_t completions = 0;
+        size_t failures = 0;
+        ide::ChannelStats before = get_total_stats();
+        Stopwatch stopwatch;
+        for (size_t batch = 0; batch < batches; batch++) {
+            for (size_t i = 0; i < read_count; i++) {
+                auto& request = reads[i].request;
+                request.lba = (batch * QUEUE_DEPTH + i % QUEUE_DEPTH) * sectors_per_read;
+                request.buffers = reads[i].buffers;
+                request.on_complete = count_completion;
+                request.context = &completions;
+                disks[i / QUEUE_DEPTH]->submit(request);
+            }
+
+            for (size_t i = 0; i < read_count; i++) {
+                disks[i / QUEUE_DEPTH]->wait(reads[i].request);
+                if (reads[i].request.bytes_transferred != SEQUENTIAL_SIZE) {
+                    failures++;
+                }
+            }
+        }
+        uint64_t ticks = stopwatch.get_elapsed_ticks();
+
+        report_disk(name, SEQUENTIAL_SIZE, batches * read_count * SEQUENTIAL_SIZE,
+            ticks, before, get_total_stats());
+        println("    {} disks, {} completions, {} failed", disks.get_size(), completions, failures);
+    }
+
+    void run_disk_benchmarks() {
+        const ide::Device* disk = nullptr;
+        for (const auto& device : ide::get_disks()) {
+            if (device.get_interface_type() == ide::InterfaceType::ATA
+                && device.get_size() >= SEQUENTIAL_SIZE / SECTOR_SIZE)
+            {
+                disk = &device;
+                break;
+            }
+        }
+
+        if (!disk) {
+            println("  No ATA disk to read from.");
+            return;
+        }
+
+        println("  {}, {} sectors, DMA {}supported",
+            disk->get_model(), disk->get_size(), disk->supports_dma() ? "" : "not ");
+
+        ByteBuffer buffer(SEQUENTIAL_SIZE);
+
+        struct Mode {
+            bool use_irqs;
+            bool use_dma;
+            bool use_multiple; // Otherwise PIO transfers one sector per DRQ.
+            StringView sequential_name;
+            StringView random_name;
+        };
+
+        // The driver polls with interrupts disabled and sleeps until
+        // the drive's IRQ with them enabled, no other IRQ is unmasked yet.
+        static const Array<Mode, 6> MODES = {{
+            { false, true, true, "sequential, DMA, polling", "random, DMA, polling" },
+            { false, false, true, "sequential, PIO multiple, polling", "random, PIO multiple, polling" },
+            { false, false, false, "sequential, PIO single, polling", "random, PIO single, polling" },
+            { true, true, true, "sequential, DMA, IRQ", "random, DMA, IRQ" },
+            { true, false, true, "sequential, PIO multiple, IRQ", "random, PIO multiple, IRQ" },
+            { true, false, false, "sequential, PIO single, IRQ", "random, PIO single, IRQ" },
+        }};
+
+        for (const auto& mode : MODES) {
+            if (mode.use_irqs) {
+                enable_interrupts();
+            }
+            ide::set_dma_enabled(mode.use_dma);
+            ide::set_multiple_enabled(mode.use_multiple);
+            bench_sequential(*disk, buffer, mode.sequential_name);
+            bench_random(*disk, buffer, mode.random_name);
+        }
+
+        ide::set_dma_enabled(true);
+        ide::set_multiple_enabled(true);
+
+        // The first ATA disk of each channel, the channels work in parallel.
+        InplaceVector<const ide::Device*, 2> queued_disks;
+        for (const auto& device : ide::get_disks()) {
+            bool channel_taken = false;
+            for (auto other : queued_disks) {
+                channel_taken |= other->get_channel_type() == device.get_channel_type();
+            }
+            if (!channel_taken && device.get_interface_type() == ide::InterfaceType::ATA
+                && device.get_size() >= QUEUE_DEPTH * SEQUENTIAL_SIZE / SECTOR_SIZE)
+            {
+                (void)queued_disks.push_back(&device);
+            }
+        }
+
+        enable_interrupts();
+        bench_queued(queued_disks, "queued, IRQ");
+        disable_interrupts();
+        bench_queued(queued_disks, "queued, polling");
+    }
+}
@@ -0,0 +1,154 @@
+#include <bench/bench.hpp>
+
+#include <kernel/print.hpp>
+#include <memory/kmalloc.hpp>
+#include <memory/heap_pages.hpp>
+#include <memory/liballoc.h>
+#include <util/array.hpp>
+
+namespace bench {
+    struct Heap {
+        StringView name;
+        void* (*allocate)(size_t size);
+        void* (*reallocate)(void* ptr, size_t size);
+        void (*free)(void* ptr);
+    };
+
+    static const Array<Heap, 2> heaps = {{
+        { "kmalloc", kmalloc, krealloc, kfree },
+        { "liballoc", liballoc_kmalloc, liballoc_krealloc, liballoc_kfree },
+    }};
+
+    static void bench_fixed_size(const Heap& heap) {
+        constexpr size_t ITERATIONS = 10'000;
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            void* ptr = heap.allocate(32);
+            do_not_optimize(ptr);
+            heap.free(ptr);
+        }
+        report("alloc/free 32 bytes", ITERATIONS, stopwatch.get_elapsed_ticks());
+    }
+
+    /**
+     * Keep a set of live allocations of mixed sizes and keep
+     * replacing random ones, so that the heap gets fragmented.
+     */
+    static void bench_fragmented(const Heap& heap) {
+        constexpr size_t SLOT_COUNT = 256;
+        constexpr size_t ITERATIONS = 20'000;
+        constexpr uint32_t MAX_SIZE = 1024;
+
+        static Array<void*, SLOT_COUNT> slots;
+        uint32_t random = 0x1234'5678;
+
+        for (auto& slot : slots) {
+            slot = heap.allocate(next_random(random) % MAX_SIZE + 1);
+        }
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            auto& slot = slots[next_random(random) % SLOT_COUNT];
+            heap.free(slot);
+            slot = heap.allocate(next_random(random) % MAX_SIZE + 1);
+        }
+        uint64_t ticks = stopwatch.get_elapsed_ticks();
+
+        for (auto& slot : slots) {
+            heap.free(slot);
+        }
+        report("mixed sizes, fragmented", ITERATIONS, ticks);
+    }
+
+    /**
+     * Grow buffers the way Vector and String do.
+     */
+    static void bench_realloc_growth(const Heap& heap) {
+        constexpr size_t ROUNDS = 200;
+        constexpr size_t MAX_SIZE = 16 * 1024;
+
+        size_t iterations = 0;
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            void* ptr = nullptr;
+            for (size_t size = 8; size <= MAX_SIZE; size = size * 3 / 2) {
+                ptr = heap.reallocate(ptr, size);
+                do_not_optimize(ptr);
+                iterations++;
+            }
+            heap.free(ptr);
+        }
+        report("realloc growth", iterations, stopwatch.get_elapsed_ticks());
+    }
+
+    /**
+     * Growing the heap: reserve a virtual range and map frames into it.
+     */
+    static void bench_heap_pages() {
+        constexpr size_t ROUNDS = 1'000;
+        constexpr size_t LIVE_COUNT = 8;
+
+        Array<void*, LIVE_COUNT> live;
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            for (size_t i = 0; i < LIVE_COUNT; i++) {
+                live[i] = heap::allocate_pages(i + 1);
+            }
+            for (size_t i = 0; i < LIVE_COUNT; i++) {
+                heap::free_pages(live[i], i + 1);
+            }
+        }
+        report("heap pages 1..8", ROUNDS * LIVE_COUNT, stopwatch.get_elapsed_ticks());
+    }
+
+    /**
+     * A big buffer of which only every 16th page gets used,
+     * mapped up front and on demand.
+     */
+    static void bench_sparse_buffer() {
+        constexpr size_t ROUNDS = 20;
+        constexpr size_t PAGE_COUNT = 256;
+        constexpr size_t STRIDE = 16;
+
+        auto touch = [](void* buffer) {
+            auto bytes = static_cast<volatile uint8_t*>(buffer);
+            for (size_t page = 0; page < PAGE_COUNT; page += STRIDE) {
+                bytes[page * paging::PAGE_SIZE] = 1;
+            }
+        };
+
+        Stopwatch eager_stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            void* buffer = heap::allocate_pages(PAGE_COUNT);
+            touch(buffer);
+            heap::free_pages(buffer, PAGE_COUNT);
+        }
+        report("sparse 1MiB buffer, eager", ROUNDS, eager_stopwatch.get_elapsed_ticks());
+
+        Stopwatch lazy_stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            void* buffer = heap::reserve_pages(PAGE_COUNT);
+            touch(buffer);
+            heap::free_pages(buffer, PAGE_COUNT);
+        }
+        report("sparse 1MiB buffer, on demand", ROUNDS, lazy_stopwatch.get_elapsed_ticks());
+    }
+
+    void run_heap_benchmarks() {
+        bench_heap_pages();
+        bench_sparse_buffer();
+
+        for (const auto& heap : heaps) {
+            println(" {}:", heap.name);
+            bench_fixed_size(heap);
+            bench_fragmented(heap);
+            bench_realloc_growth(heap);
+        }
+
+        auto stats = kmalloc_get_stats();
+        println("  kmalloc CPU cache: {} hits, {} misses; lock taken {} times, contended {}",
+            stats.cache_hits, stats.cache_misses,
+            stats.lock_acquisitions, stats.lock_contentions);
+    }
+}
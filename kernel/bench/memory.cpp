@@ -0,0 +1,83 @@
+#include <bench/bench.hpp>
+
+#include <arch/i386/cpu.hpp>
+#include <kernel/log.hpp>
+#include <kernel/print.hpp>
+#include <memory/kmalloc.hpp>
+#include <util/array.hpp>
+#include <util/math.hpp>
+#include <util/memory.hpp>
+
+namespace bench {
+    static constexpr Array<size_t, 8> SIZES = {{
+        64, 256, 1024, 4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024,
+    }};
+
+    /**
+     * Room for the biggest size plus misaligned and overlapping copies.
+     */
+    static constexpr size_t BUFFER_SIZE = 1024 * 1024 + 64;
+
+    /**
+     * Bytes processed for every size.
+     */
+    static constexpr size_t BYTES_PER_SIZE = 16 * 1024 * 1024;
+
+    template <typename Operation>
+    static void bench_throughput(StringView name, size_t size, Operation operation) {
+        size_t iterations = max(BYTES_PER_SIZE / size, 1);
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < iterations; i++) {
+            operation();
+        }
+        report_throughput(name, size, iterations * size, stopwatch.get_elapsed_ticks());
+    }
+
+    void run_memory_benchmarks() {
+        auto src = static_cast<uint8_t*>(kmalloc(BUFFER_SIZE));
+        auto dst = static_cast<uint8_t*>(kmalloc(BUFFER_SIZE));
+        if (!src || !dst) {
+            LOG_ERROR("Failed to allocate the memory benchmark buffers.");
+            kfree(src);
+            kfree(dst);
+            return;
+        }
+
+        // Commit the pages before measuring.
+        memset(src, 0xaa, BUFFER_SIZE);
+        memset(dst, 0, BUFFER_SIZE);
+
+        println("  ERMS: {}", cpu::has_feature(cpu::Feature::ERMS) ? "yes" : "no");
+
+        for (size_t size : SIZES) {
+            bench_throughput("memcpy", size, [=]() {
+                memcpy(dst, src, size);
+                do_not_optimize(dst);
+            });
+
+            bench_throughput("memcpy unaligned", size, [=]() {
+                memcpy(dst + 1, src + 3, size);
+                do_not_optimize(dst);
+            });
+
+            bench_throughput("memmove overlapping", size, [=]() {
+                memmove(dst + 4, dst, size);
+                do_not_optimize(dst);
+            });
+
+            bench_throughput("memset", size, [=]() {
+                memset(dst, 0, size);
+                do_not_optimize(dst);
+            });
+
+            memcpy(dst, src, size);
+            bench_throughput("memcmp", size, [=]() {
+                do_not_optimize(memcmp(dst, src, size));
+            });
+        }
+
+        kfree(src);
+        kfree(dst);
+    }
+}
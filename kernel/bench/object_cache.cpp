@@ -0,0 +1,76 @@
+#include <bench/bench.hpp>
+
+#include <memory/kmalloc.hpp>
+#include <memory/object_cache.hpp>
+#include <util/array.hpp>
+
+namespace bench {
+    struct Object {
+        uint32_t data[16];
+    };
+
+    static ObjectCache<Object> object_cache("bench object");
+
+    static constexpr size_t BATCH_SIZE = 256;
+    static constexpr size_t ROUNDS = 100;
+
+    static Array<Object*, BATCH_SIZE> objects;
+
+    static void bench_cache_single() {
+        constexpr size_t ITERATIONS = 10'000;
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            Object* object = object_cache.allocate();
+            do_not_optimize(object);
+            object_cache.free(object);
+        }
+        report("cache alloc/free", ITERATIONS, stopwatch.get_elapsed_ticks());
+    }
+
+    static void bench_kmalloc_single() {
+        constexpr size_t ITERATIONS = 10'000;
+
+        Stopwatch stopwatch;
+        for (size_t i = 0; i < ITERATIONS; i++) {
+            void* object = kmalloc(sizeof(Object));
+            do_not_optimize(object);
+            kfree(object);
+        }
+        report("kmalloc alloc/free", ITERATIONS, stopwatch.get_elapsed_ticks());
+    }
+
+    static void bench_cache_batch() {
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            for (auto& object : objects) {
+                object = object_cache.allocate();
+            }
+            for (auto object : objects) {
+                object_cache.free(object);
+            }
+        }
+        report("cache batch of 256", ROUNDS * BATCH_SIZE, stopwatch.get_elapsed_ticks());
+    }
+
+    static void bench_kmalloc_batch() {
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            for (auto& object : objects) {
+                object = static_cast<Object*>(kmalloc(sizeof(Object)));
+            }
+            for (auto object : objects) {
+                kfree(object);
+            }
+        }
+        report("kmalloc batch of 256", ROUNDS * BATCH_SIZE, stopwatch.get_elapsed_ticks());
+    }
+
+    void run_object_cache_benchmarks() {
+        bench_cache_single();
+        bench_kmalloc_single();
+        bench_cache_batch();
+        bench_kmalloc_batch();
+        object_cache.reclaim();
+    }
+}
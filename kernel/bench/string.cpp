@@ -0,0 +1,202 @@
+#include <bench/bench.hpp>
+
+#include <disk/disk.hpp>
+#include <fs/fat.hpp>
+#include <kernel/print.hpp>
+#include <util/array.hpp>
+#include <util/byte_buffer.hpp>
+#include <util/memory.hpp>
+#include <util/string.hpp>
+#include <util/vector.hpp>
+
+namespace bench {
+    static constexpr size_t SECTOR_SIZE = 512;
+
+    /**
+     * A FAT16 image with just the boot sector, one FAT sector and
+     * a big root directory.
+     */
+    static constexpr size_t FAT_SECTOR = 1;
+    static constexpr size_t ROOT_SECTOR = 2;
+    static constexpr size_t ROOT_SECTORS = 255;
+    static constexpr size_t ROOT_ENTRIES = ROOT_SECTORS * SECTOR_SIZE / 32;
+    static constexpr size_t IMAGE_SECTORS = ROOT_SECTOR + ROOT_SECTORS;
+
+    class RamDisk : public IDisk {
+    public:
+        explicit RamDisk(Span<const uint8_t> data) : data(data) {}
+
+        size_t read(uint64_t lba, Span<uint8_t> buffer) const override {
+            size_t size = buffer.get_size() / SECTOR_SIZE * SECTOR_SIZE;
+            if (lba * SECTOR_SIZE + size > data.get_size()) {
+                return 0;
+            }
+            memcpy(buffer.begin(), data.begin() + lba * SECTOR_SIZE, size);
+            return size;
+        }
+
+        size_t write(uint64_t, Span<uint8_t>) const override {
+            return 0;
+        }
+
+    private:
+        Span<const uint8_t> data;
+    };
+
+    static void put_u16(uint8_t* at, uint16_t value) {
+        at[0] = value;
+        at[1] = value >> 8;
+    }
+
+    static void put_u32(uint8_t* at, uint32_t value) {
+        put_u16(at, value);
+        put_u16(at + 2, value >> 16);
+    }
+
+    /**
+     * Write `prefix` followed by `number` as 4 digits.
+     */
+    static size_t format_name(char* out, StringView prefix, size_t number) {
+        memcpy(out, prefix.begin(), prefix.get_size());
+        for (size_t i = 0; i < 4; i++) {
+            out[prefix.get_size() + 3 - i] = '0' + number % 10;
+            number /= 10;
+        }
+        return prefix.get_size() + 4;
+    }
+
+    /**
+     * Long names get longer with the file number: none, one, two and
+     * three long name entries, the last ones do not fit inline.
+     */
+    static size_t get_file_name(char* out, size_t file) {
+        static const Array<StringView, 4> PREFIXES = {{
+            "", "file-", "a-longer-name-", "a-much-longer-file-name-",
+        }};
+        static const StringView EXTENSION = ".txt";
+
+        size_t length = format_name(out, PREFIXES[file % 4], file);
+        memcpy(out + length, EXTENSION.begin(), EXTENSION.get_size());
+        return length + EXTENSION.get_size();
+    }
+
+    static void write_short_entry(uint8_t* entry, size_t file) {
+        memset(entry, ' ', 11);
+        format_name(reinterpret_cast<char*>(entry), "FILE", file);
+        memcpy(entry + 8, "TXT", 3);
+        entry[11] = 0x20; // Archive.
+    }
+
+    static void write_long_entry(uint8_t* entry, StringView name, size_t order, bool last) {
+        constexpr Array<size_t, 13> CHAR_OFFSETS = {{
+            1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30,
+        }};
+
+        entry[0] = order | (last ? 0x40 : 0);
+        entry[11] = 0x0f; // Long name.
+        for (size_t i = 0; i < CHAR_OFFSETS.get_size(); i++) {
+            size_t index = (order - 1) * 13 + i;
+            uint16_t ch = index < name.get_size() ? name[index]
+                : index == name.get_size() ? 0 : 0xffff;
+            put_u16(entry + CHAR_OFFSETS[i], ch);
+        }
+    }
+
+    /**
+     * Fill the root directory, return the number of files in it.
+     */
+    static size_t create_image(ByteBuffer& image) {
+        memset(image.begin(), 0, image.get_size());
+
+        uint8_t* boot = image.begin();
+        put_u16(boot + 11, SECTOR_SIZE);
+        boot[13] = 4; // Sectors per cluster.
+        put_u16(boot + 14, FAT_SECTOR); // Reserved sectors.
+        boot[16] = 1; // FAT count.
+        put_u16(boot + 17, ROOT_ENTRIES);
+        put_u16(boot + 22, 1); // Sectors per FAT.
+        put_u32(boot + 32, 100'000); // Enough clusters for FAT16.
+
+        auto entries = image.begin() + ROOT_SECTOR * SECTOR_SIZE;
+        size_t slot = 0;
+        size_t file = 0;
+        for (;; file++) {
+            Array<char, 64> name;
+            size_t length = get_file_name(name.begin(), file);
+            size_t long_entries = file % 4 == 0 ? 0 : (length + 12) / 13;
+            if (slot + long_entries + 1 > ROOT_ENTRIES) {
+                break;
+            }
+
+            for (size_t order = long_entries; order > 0; order--) {
+                write_long_entry(entries + slot * 32, { name.begin(), length },
+                    order, order == long_entries);
+                slot++;
+            }
+            write_short_entry(entries + slot * 32, file);
+            slot++;
+        }
+        return file;
+    }
+
+    static void bench_list_directory() {
+        constexpr size_t ROUNDS = 10;
+
+        ByteBuffer image(IMAGE_SECTORS * SECTOR_SIZE);
+        size_t file_count = create_image(image);
+        RamDisk disk(image);
+
+        auto fs = fat::FatFS::try_read(disk);
+        if (!fs.has_value()) {
+            println("  Failed to read the test image.");
+            return;
+        }
+
+        size_t listed = 0;
+        size_t allocations = count_allocations();
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            auto files = fs.get_value().list_root();
+            listed = files.has_value() ? files.get_value().get_size() : 0;
+        }
+        uint64_t ticks = stopwatch.get_elapsed_ticks();
+        allocations = count_allocations() - allocations;
+
+        report("list root directory", ROUNDS, ticks);
+        println("    {} of {} files listed, {} allocations per listing",
+            listed, file_count, allocations / ROUNDS);
+    }
+
+    /**
+     * Build the same names char by char, the way directory
+     * listing used to, in a Vector<char> and in a String.
+     */
+    template <typename Name>
+    static void bench_build_names(StringView name) {
+        constexpr size_t NAME_COUNT = 4'000;
+
+        size_t allocations = count_allocations();
+        Stopwatch stopwatch;
+        for (size_t file = 0; file < NAME_COUNT; file++) {
+            Array<char, 64> chars;
+            size_t length = get_file_name(chars.begin(), file);
+
+            Name result;
+            for (size_t i = 0; i < length; i++) {
+                result.push_back(chars[i]);
+            }
+            do_not_optimize(result.begin());
+        }
+        uint64_t ticks = stopwatch.get_elapsed_ticks();
+        allocations = count_allocations() - allocations;
+
+        report(name, NAME_COUNT, ticks);
+        println("    {} allocations for {} names", allocations, NAME_COUNT);
+    }
+
+    void run_string_benchmarks() {
+        bench_build_names<Vector<char>>("names in Vector<char>");
+        bench_build_names<String>("names in String");
+        bench_list_directory();
+    }
+}
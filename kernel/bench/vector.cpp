@@ -0,0 +1,78 @@
+#include <bench/bench.hpp>
+
+#include <kernel/print.hpp>
+#include <util/string.hpp>
+#include <util/vector.hpp>
+
+namespace bench {
+    static constexpr size_t ITEM_COUNT = 4'000;
+    static constexpr size_t ROUNDS = 10;
+
+    /**
+     * Same as a String, but without the trait, so a Vector
+     * moves it item by item when growing.
+     */
+    struct MovedName {
+        explicit MovedName(StringView name) : name(name) {}
+
+        String name;
+    };
+
+    /**
+     * Run `fill` on a fresh Vector `ROUNDS` times and report the time
+     * and allocations per round.
+     */
+    template <typename T, typename Fill>
+    static void bench_fill(StringView name, Fill fill) {
+        size_t allocations = count_allocations();
+        Stopwatch stopwatch;
+        for (size_t round = 0; round < ROUNDS; round++) {
+            Vector<T> items;
+            fill(items);
+            do_not_optimize(items.begin());
+        }
+        uint64_t ticks = stopwatch.get_elapsed_ticks();
+        allocations = count_allocations() - allocations;
+
+        report(name, ROUNDS * ITEM_COUNT, ticks);
+        println("    {} allocations per {} items", allocations / ROUNDS, ITEM_COUNT);
+    }
+
+    void run_vector_benchmarks() {
+        bench_fill<uint32_t>("push_back uint32_t", [](Vector<uint32_t>& items) {
+            for (size_t i = 0; i < ITEM_COUNT; i++) {
+                items.push_back(i);
+            }
+        });
+
+        bench_fill<uint32_t>("push_back uint32_t, reserved", [](Vector<uint32_t>& items) {
+            items.reserve(ITEM_COUNT);
+            for (size_t i = 0; i < ITEM_COUNT; i++) {
+                items.push_back(i);
+            }
+        });
+
+        bench_fill<String>("emplace_back String, relocated", [](Vector<String>& items) {
+            for (size_t i = 0; i < ITEM_COUNT; i++) {
+                items.emplace_back("some-file-name.txt");
+            }
+        });
+
+        bench_fill<MovedName>("emplace_back String, moved", [](Vector<MovedName>& items) {
+            for (size_t i = 0; i < ITEM_COUNT; i++) {
+                items.emplace_back("some-file-name.txt");
+            }
+        });
+
+        bench_fill<uint32_t>("push_back/pop_back stack", [](Vector<uint32_t>& items) {
+            for (size_t i = 0; i < ITEM_COUNT / 64; i++) {
+                for (size_t j = 0; j < 64; j++) {
+                    items.push_back(j);
+                }
+                while (items.get_size() > 0) {
+                    items.pop_back();
+                }
+            }
+        });
+    }
+}
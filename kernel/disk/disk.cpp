@@ -0,0 +1,60 @@
+#include <disk/disk.hpp>
+
+#include <arch/i386/asm.hpp>
+
+size_t DiskRequest::get_size() const {
+    size_t size = 0;
+    for (const auto& buffer : buffers) {
+        size += buffer.get_size();
+    }
+    return size;
+}
+
+void DiskRequest::complete(size_t transferred) {
+    bytes_transferred = transferred;
+    if (on_complete) {
+        on_complete(*this);
+    }
+    __atomic_store_n(&completed, true, __ATOMIC_RELEASE);
+}
+
+bool IDisk::prepare_request(DiskRequest& request) const {
+    for (const auto& buffer : request.buffers) {
+        if (buffer.get_size() % SECTOR_SIZE != 0) {
+            return false;
+        }
+    }
+
+    request.bytes_transferred = 0;
+    request.completed = false;
+    request.disk = this;
+    request.next = nullptr;
+    return true;
+}
+
+bool IDisk::submit(DiskRequest& request) const {
+    if (!prepare_request(request)) {
+        return false;
+    }
+
+    size_t transferred = 0;
+    uint64_t lba = request.lba;
+    for (const auto& buffer : request.buffers) {
+        size_t done = request.write ? write(lba, buffer) : read(lba, buffer);
+        transferred += done;
+        if (done != buffer.get_size()) {
+            break;
+        }
+        lba += buffer.get_size() / SECTOR_SIZE;
+    }
+
+    request.complete(transferred);
+    return true;
+}
+
+void IDisk::wait(const DiskRequest& request) const {
+    while (!request.is_completed()) {
+        poll();
+        pause();
+    }
+}
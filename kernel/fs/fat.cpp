@@ -118,7 +118,7 @@ namespace fat {
 
     Option<FatFS> FatFS::try_read(const IDisk& disk) {
         Array<uint8_t, 512> boot_sector;
-        if (!disk.read(0, boot_sector)) {
+        if (disk.read(0, boot_sector) != boot_sector.get_size()) {
             LOG_ERROR("Failed to read boot sector.");
             return {};
         }
@@ -236,6 +236,18 @@ namespace fat {
         }
     };
 
+    /**
+     * Return a name field up to the spaces padding it.
+     */
+    template <size_t SIZE>
+    static StringView trim_padding(const Array<char, SIZE>& field) {
+        size_t length = 0;
+        while (length < SIZE && field[length] != ' ') {
+            length++;
+        }
+        return { field.begin(), length };
+    }
+
     Option<DirEntry> DirectoryParser::read_entry(const FatDirEntry& dir_entry) {
         // Assume it's a file entry.
         const auto& entry = dir_entry.file;
@@ -259,17 +271,10 @@ namespace fat {
             file.name = move(long_name_buffer);
             long_name_buffer = String();
         } else {
-            for (auto ch : entry.name) {
-                if (ch == ' ') break;
-                file.name.push_back(ch);
-            }
-
+            file.name.append(trim_padding(entry.name));
             if (entry.extension[0] != ' ') {
                 file.name.push_back('.');
-                for (auto ch : entry.extension) {
-                    if (ch == ' ') break;
-                    file.name.push_back(ch);
-                }
+                file.name.append(trim_padding(entry.extension));
             }
         }   
 
@@ -280,7 +285,7 @@ namespace fat {
         uint32_t first, uint32_t count, Vector<DirEntry>& list)
     {
         ByteBuffer data(count * 512);
-        if (!fs.disk.read(first, data)) return false;
+        if (fs.disk.read(first, data) != data.get_size()) return false;
 
         Span<const FatDirEntry> entries{
             reinterpret_cast<const FatDirEntry*>(data.begin()),
@@ -326,10 +331,15 @@ namespace fat {
                 return {};
             }
         } else {
+            // The size is fixed, long names take several entries,
+            // so this is the most files there can be.
+            list.reserve(root_sectors * 512 / sizeof(FatDirEntry));
             if (!parser.read_sectors(root_start, root_sectors, list)) {
                 return {};
             }
         }
+
+        list.shrink_to_fit();
         return list;
     }
 
@@ -349,7 +359,7 @@ namespace fat {
         auto sector = first_fat_sector + (offset / 512);
         auto entry_offset = offset % 512;
 
-        if (!disk.read(sector, buffer)) {
+        if (disk.read(sector, buffer) != buffer.get_size()) {
             LOG_ERROR("Failed to read the FAT.");
             return {};
         }
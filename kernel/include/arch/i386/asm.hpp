@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 
 inline void outl(uint16_t address, uint32_t data) {
     asm volatile("outl %1, %0"
@@ -44,6 +45,35 @@ inline uint8_t inb(uint16_t address) {
     return result;
 }
 
+/**
+ * Read `count` words from `address` into `buffer`.
+ */
+inline void insw(uint16_t address, void* buffer, size_t count) {
+    asm volatile("rep insw"
+        : "+D" (buffer), "+c" (count)
+        : "d" (address)
+        : "memory");
+}
+
+/**
+ * Write `count` words from `buffer` to `address`.
+ */
+inline void outsw(uint16_t address, const void* buffer, size_t count) {
+    asm volatile("rep outsw"
+        : "+S" (buffer), "+c" (count)
+        : "d" (address)
+        : "memory");
+}
+
+/**
+ * Read the time stamp counter.
+ */
+inline uint64_t rdtsc() {
+    uint64_t result;
+    asm volatile("rdtsc" : "=A" (result));
+    return result;
+}
+
 inline void io_wait() {
     outb(0x80, 0);
 }
@@ -56,10 +86,58 @@ inline void enable_interrupts() {
     asm volatile("sti");
 }
 
+/**
+ * Disable interrupts and return the previous EFLAGS value
+ * to be passed to `restore_interrupts`.
+ */
+inline uint32_t save_and_disable_interrupts() {
+    uint32_t flags;
+    asm volatile(
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "cli"
+        : "=r"(flags) : : "memory");
+    return flags;
+}
+
+/**
+ * Re-enable interrupts if they were enabled in `flags`.
+ */
+inline void restore_interrupts(uint32_t flags) {
+    if (flags & (1 << 9)) {
+        asm volatile("sti" : : : "memory");
+    }
+}
+
+/**
+ * To be used in spin loops.
+ */
+inline void pause() {
+    asm volatile("pause");
+}
+
 inline void hlt() {
     asm volatile("hlt");
 }
 
+inline bool are_interrupts_enabled() {
+    uint32_t flags;
+    asm volatile(
+        "pushfl\n\t"
+        "popl %0"
+        : "=r"(flags));
+    return flags & (1 << 9);
+}
+
+/**
+ * Wait for an interrupt with interrupts enabled. Call with them
+ * disabled: `sti` only takes effect after the next instruction,
+ * so one arriving right after a check still wakes the CPU up.
+ */
+inline void enable_interrupts_and_halt() {
+    asm volatile("sti\n\thlt" : : : "memory");
+}
+
 /**
  * To be used in polling loops.
  */
@@ -93,3 +171,62 @@ inline uint32_t read_cr3() {
         : "=r"(result));
     return result;
 }
+
+inline uint32_t read_cr4() {
+    uint32_t result;
+    asm volatile(
+        "movl %%cr4, %0"
+        : "=r"(result));
+    return result;
+}
+
+inline void write_cr4(uint32_t value) {
+    asm volatile(
+        "movl %0, %%cr4"
+        : : "r"(value));
+}
+
+inline uint64_t rdmsr(uint32_t msr) {
+    uint64_t result;
+    asm volatile("rdmsr" : "=A" (result) : "c" (msr));
+    return result;
+}
+
+inline void wrmsr(uint32_t msr, uint64_t value) {
+    asm volatile("wrmsr" : : "c" (msr), "A" (value));
+}
+
+struct CpuidResult {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+};
+
+inline CpuidResult cpuid(uint32_t leaf, uint32_t subleaf = 0) {
+    CpuidResult result;
+    asm volatile("cpuid"
+        : "=a" (result.eax), "=b" (result.ebx), "=c" (result.ecx), "=d" (result.edx)
+        : "a" (leaf), "c" (subleaf));
+    return result;
+}
+
+/**
+ * CR2 holds the address that caused the last page fault.
+ */
+inline uint32_t read_cr2() {
+    uint32_t result;
+    asm volatile(
+        "movl %%cr2, %0"
+        : "=r"(result));
+    return result;
+}
+
+/**
+ * Invalidate the TLB entry for the page containing `address`.
+ */
+inline void invlpg(uint32_t address) {
+    asm volatile(
+        "invlpg (%0)"
+        : : "r"(address) : "memory");
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace cpu {
+    /**
+     * Only the bootstrap processor is started for now.
+     */
+    static constexpr size_t MAX_CPUS = 1;
+
+    /**
+     * Return the index of the current processor (0..MAX_CPUS).
+     * Stays the same as long as interrupts are disabled.
+     */
+    inline size_t get_current_index() {
+        return 0;
+    }
+
+    enum class Feature {
+        PSE, // 4MiB pages.
+        PAE, // Physical Address Extension.
+        NX, // No-execute page bit.
+        ERMS, // Enhanced REP MOVSB/STOSB, fast for any size.
+    };
+
+    /**
+     * Ask CPUID whether the processor supports the feature.
+     */
+    bool has_feature(Feature feature);
+
+    /**
+     * Return the number of physical address bits.
+     */
+    unsigned get_physical_address_bits();
+}
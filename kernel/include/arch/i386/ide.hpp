@@ -42,6 +42,12 @@ namespace ide {
         WRITE,
     };
 
+    enum class TransferMode {
+        DMA,
+        PIO_MULTIPLE, // READ/WRITE MULTIPLE, a block of sectors per interrupt.
+        PIO,
+    };
+
     enum class PollingResult {
         SUCCESS,
         ERROR,
@@ -49,6 +55,19 @@ namespace ide {
         REQUEST_NOT_READY,
     };
 
+    /**
+     * Times are in TSC ticks.
+     */
+    struct ChannelStats {
+        size_t dma_transfers;
+        size_t pio_transfers;
+        size_t irqs;
+        uint64_t busy_ticks; // From issuing commands to their completion.
+        uint64_t max_latency_ticks; // Of a single command.
+        uint64_t wait_ticks; // Spent waiting for the drive.
+        uint64_t sleep_ticks; // Part of wait_ticks the CPU was halted until an IRQ.
+    };
+
     class Device : public IDisk {
     public:
         constexpr Device()
@@ -61,12 +80,29 @@ namespace ide {
         /**
          * See IDisk::read.
          */
-        bool read(uint64_t lba, Span<uint8_t> buffer) const override;
+        size_t read(uint64_t lba, Span<uint8_t> buffer) const override;
 
         /**
          * See IDisk::write.
          */
-        bool write(uint64_t lba, Span<uint8_t> buffer) const override;
+        size_t write(uint64_t lba, Span<uint8_t> buffer) const override;
+
+        /**
+         * See IDisk::submit. Requests are queued per channel, the two
+         * channels work at the same time.
+         */
+        bool submit(DiskRequest& request) const override;
+
+        /**
+         * See IDisk::poll.
+         */
+        void poll() const override;
+
+        /**
+         * See IDisk::wait. Halts until the next interrupt
+         * if interrupts are enabled.
+         */
+        void wait(const DiskRequest& request) const override;
 
         /**
          * Return size in sectors.
@@ -82,8 +118,19 @@ namespace ide {
          * Return model name.
          */
         StringView get_model() const;
+
+        ChannelType get_channel_type() const {
+            return channel_type;
+        }
+
+        /**
+         * Return true if the drive can do DMA transfers.
+         */
+        bool supports_dma() const;
     
     private:
+        friend class RequestQueue;
+
         ChannelType channel_type;
         DriveType drive_type;
         InterfaceType interface = InterfaceType::ATA;
@@ -91,20 +138,75 @@ namespace ide {
         uint16_t features = 0;
         uint32_t command_sets = 0; // Command sets supported.
         uint32_t size = 0; // Size in sectors.
+        uint8_t multiple_sectors = 0; // Per DRQ block with READ/WRITE MULTIPLE, 0 if not set up.
         Array<char, 41> model;
 
         /**
-         * Access the drive (read or write).
-         * Sector count is the whole number of sectors that
-         * can fit in `buffer`.
+         * Make READ/WRITE MULTIPLE transfer up to `max_sectors` per block.
+         */
+        void set_multiple_mode(uint8_t max_sectors);
+
+        /**
+         * Access the drive (read or write), as many whole sectors
+         * as fit in `buffer`, split into as few commands as possible.
+         * Return the number of bytes transferred.
+         */
+        size_t access(
+            Direction direction,
+            uint64_t lba,
+            Span<uint8_t> buffer) const;
+
+        /**
+         * Transfer the beginning of `buffer` with one command. Return
+         * the number of bytes transferred, 0 on an error.
          */
-        PollingResult access(
+        size_t run_command(
             Direction direction,
             uint64_t lba,
             Span<uint8_t> buffer) const;
+
+        size_t get_max_command_sectors() const;
+
+        /**
+         * Return the PIO mode to use when DMA is not possible.
+         */
+        TransferMode get_pio_mode() const;
+
+        /**
+         * Return the number of sectors per DRQ block in `mode`.
+         */
+        uint8_t get_block_size(TransferMode mode) const;
+
+        /**
+         * Select the drive and send the command for a transfer. The data is
+         * then up to the caller. Return true if it is an LBA48 command.
+         */
+        bool issue_command(
+            Direction direction,
+            uint64_t lba,
+            size_t sector_count,
+            TransferMode mode) const;
     };
 
     void init(const pci::Function& func);
 
+    /**
+     * Choose between bus-master DMA, used when both the controller and
+     * the drive support it (the default), and PIO for all transfers.
+     */
+    void set_dma_enabled(bool enabled);
+
+    /**
+     * Choose between READ/WRITE MULTIPLE, interrupting once per block of
+     * sectors (the default), and one interrupt per sector for PIO transfers.
+     */
+    void set_multiple_enabled(bool enabled);
+
+    /**
+     * Commands are counted as DMA or PIO transfers. The CPU
+     * was free for `sleep_ticks` out of `busy_ticks`.
+     */
+    ChannelStats get_channel_stats(ChannelType channel);
+
     Span<const ide::Device> get_disks();
 }
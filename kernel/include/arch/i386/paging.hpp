@@ -1,19 +1,104 @@
 #pragma once
 
+#include <stdint.h>
 #include <stddef.h>
+#include <util/assert.hpp>
 #include <util/option.hpp>
 
 namespace paging {
     static constexpr size_t PAGE_SIZE = 4096;
 
-    using PhysAddr = size_t;
+    /**
+     * Unit of large mappings. One page directory entry without PAE,
+     * two with PAE (its large pages are 2MiB).
+     */
+    static constexpr size_t LARGE_PAGE_SIZE = 4 * 1024 * 1024;
+
+    /**
+     * Physical addresses go above 4GiB with PAE.
+     */
+    using PhysAddr = uint64_t;
 
     using VirtAddr = size_t;
 
+    /**
+     * The kernel runs in the last GiB of the address space,
+     * the rest is left for user space.
+     */
+    static constexpr VirtAddr KERNEL_BASE = 0xc000'0000;
+
+    /**
+     * Physical memory is mapped linearly from KERNEL_BASE up to here
+     * (the first 512MiB of it), the kernel's image included.
+     */
+    static constexpr VirtAddr PHYSMAP_END = 0xe000'0000;
+    static constexpr PhysAddr PHYSMAP_SIZE = PHYSMAP_END - KERNEL_BASE;
+
+    /**
+     * The part of the physmap `boot.s` sets up, the rest of it
+     * only exists after `init`.
+     */
+    static constexpr PhysAddr BOOT_MAP_END = 0x40'0000;
+
+    /**
+     * Window of pages for `map_temporary`, right after the heap.
+     */
+    static constexpr VirtAddr TEMPORARY_MAP_START = 0xff00'0000;
+    static constexpr size_t TEMPORARY_MAP_SLOTS = 1024;
+
+    /**
+     * Page tables are mapped recursively from here to the end of the
+     * address space (the last 4MiB without PAE, the last 8MiB with it).
+     * Nothing else may be mapped there.
+     */
+    static constexpr VirtAddr PAGE_TABLES_START = 0xff80'0000;
+
+    static_assert(TEMPORARY_MAP_START + TEMPORARY_MAP_SLOTS * PAGE_SIZE <= PAGE_TABLES_START);
+
+    /**
+     * Return the physmap address of `addr`, it must be below PHYSMAP_SIZE.
+     */
+    template <typename T = void>
+    inline T* to_virtual(PhysAddr addr) {
+        ASSERT(addr < PHYSMAP_SIZE);
+        return reinterpret_cast<T*>(static_cast<VirtAddr>(addr) + KERNEL_BASE);
+    }
+
+    /**
+     * Return the physical address of a pointer into the physmap.
+     */
+    inline PhysAddr to_physical(const void* pointer) {
+        auto addr = reinterpret_cast<VirtAddr>(pointer);
+        ASSERT(addr >= KERNEL_BASE && addr < PHYSMAP_END);
+        return addr - KERNEL_BASE;
+    }
+
+    /**
+     * Return the highest physical address the paging mode `init`
+     * is going to pick can map. Can be called before `init`.
+     */
+    PhysAddr get_max_address();
+
     void init();
 
+    /**
+     * Return true if PAE paging is used.
+     */
+    bool is_pae_enabled();
+
     struct PageFlags {
         bool writable;
+
+        /**
+         * Map LARGE_PAGE_SIZE bytes. Large pages are used if supported
+         * and both addresses are aligned, 4KiB pages otherwise.
+         */
+        bool large;
+
+        /**
+         * Pages are not executable by default if the CPU supports NX.
+         */
+        bool executable;
     };
 
     /**
@@ -23,14 +108,42 @@ namespace paging {
     bool map(VirtAddr page, PhysAddr frame, PageFlags flags);
 
     /**
-     * Unmap the page containing `page`.
+     * Unmap the page containing `page`. A large page containing
+     * it gets split into 4KiB pages first.
      */
     void unmap(VirtAddr page);
 
+    /**
+     * Unmap the large mapping starting at `page`.
+     */
+    void unmap_large(VirtAddr page);
+
+    /**
+     * Return true if the address is mapped by a large page.
+     */
+    bool is_large_page(VirtAddr address);
+
+    /**
+     * Return true if large pages can be used.
+     */
+    bool supports_large_pages();
+
     /**
      * Return true if the page containing the address is mapped.
      */
     bool is_mapped(VirtAddr address);
 
     Option<PhysAddr> translate(VirtAddr address);
+
+    /**
+     * Map the frame containing `frame` into the temporary window,
+     * for frames that are not mapped anywhere else (high memory).
+     * Return nullptr if all the slots are taken.
+     */
+    void* map_temporary(PhysAddr frame);
+
+    /**
+     * Release a page returned by `map_temporary`.
+     */
+    void unmap_temporary(void* page);
 }
@@ -23,6 +23,11 @@ namespace pci {
         uint8_t get_prog_if() const;
         bool has_multiple_functions() const;
 
+        /**
+         * Let the device access memory on its own (DMA).
+         */
+        void enable_bus_mastering() const;
+
         /**
          * Read I/O port written in a Base Address Regiter.
          * Does not work for PCI-to-CardBus.
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <arch/i386/paging.hpp>
+
+/**
+ * TLB invalidation.
+ *
+ * Page table changes that remove or change a mapping have to be
+ * followed by a flush. Adding a mapping where there was none does
+ * not, the TLB does not cache non-present entries.
+ */
+namespace tlb {
+    /**
+     * Above this many pages it is cheaper to flush everything.
+     */
+    static constexpr size_t FLUSH_ALL_THRESHOLD = 32;
+
+    void flush_page(paging::VirtAddr page);
+
+    /**
+     * Flush `page_count` pages from `start`, or the whole TLB
+     * if there are more than FLUSH_ALL_THRESHOLD.
+     */
+    void flush_range(paging::VirtAddr start, size_t page_count);
+
+    /**
+     * Flush the whole TLB by reloading CR3.
+     */
+    void flush_all();
+
+    /**
+     * While a batch is open, `flush_page` only records the page
+     * and the flush happens once the last batch ends. Do not release
+     * the virtual addresses for reuse before the batch ends.
+     */
+    void begin_batch();
+    void end_batch();
+
+    /**
+     * Keeps a batch open until the end of the scope.
+     */
+    class BatchGuard {
+    public:
+        BatchGuard() {
+            begin_batch();
+        }
+
+        BatchGuard(const BatchGuard& other) = delete;
+        BatchGuard& operator=(const BatchGuard& other) = delete;
+
+        ~BatchGuard() {
+            end_batch();
+        }
+    };
+
+    struct Stats {
+        size_t page_flushes;
+        size_t full_flushes;
+    };
+
+    Stats get_stats();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Time stamp counter, used to time benchmarks.
+ */
+namespace tsc {
+    /**
+     * Measure the TSC frequency against the PIT.
+     * Interrupts should be disabled.
+     */
+    void calibrate();
+
+    /**
+     * Return the TSC frequency in kHz, zero if not calibrated.
+     */
+    uint64_t get_frequency_khz();
+
+    /**
+     * Convert TSC ticks to nanoseconds.
+     */
+    uint64_t to_nanoseconds(uint64_t ticks);
+}
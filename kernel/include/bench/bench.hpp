@@ -0,0 +1,75 @@
+/**
+ * @file
+ * In-kernel microbenchmarks.
+ *
+ * Run when the kernel command line contains "bench",
+ * see bench.sh in the repository root.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <arch/i386/asm.hpp>
+#include <util/string_view.hpp>
+
+namespace bench {
+    /**
+     * Run all the benchmarks and print the results.
+     */
+    void run_all();
+
+    class Stopwatch {
+    public:
+        Stopwatch() : start(rdtsc()) {}
+
+        uint64_t get_elapsed_ticks() const {
+            return rdtsc() - start;
+        }
+
+    private:
+        uint64_t start;
+    };
+
+    /**
+     * Print the time per iteration of a benchmark.
+     */
+    void report(StringView name, size_t iterations, uint64_t ticks);
+
+    /**
+     * Print the throughput of a benchmark working on `size` bytes
+     * at a time, `bytes` in total.
+     */
+    void report_throughput(StringView name, size_t size, uint64_t bytes, uint64_t ticks);
+
+    /**
+     * Return the number of kmalloc allocations since boot.
+     */
+    size_t count_allocations();
+
+    /**
+     * Keep the compiler from optimizing the value away.
+     */
+    template <typename T>
+    inline void do_not_optimize(const T& value) {
+        asm volatile("" : : "r" (value) : "memory");
+    }
+
+    /**
+     * xorshift32, good enough to pick sizes or sectors.
+     */
+    inline uint32_t next_random(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    void run_heap_benchmarks();
+    void run_object_cache_benchmarks();
+    void run_memory_benchmarks();
+    void run_string_benchmarks();
+    void run_vector_benchmarks();
+    void run_bounds_benchmarks();
+    void run_disk_benchmarks();
+}
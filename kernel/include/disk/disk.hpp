@@ -1,24 +1,105 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
 #include <util/span.hpp>
 
+class IDisk;
+
+/**
+ * Asynchronous disk request, see IDisk::submit.
+ */
+struct DiskRequest {
+    using Callback = void (*)(DiskRequest& request);
+
+    bool write = false;
+    uint64_t lba = 0;
+
+    /**
+     * Scatter-gather list, transferred one after another starting
+     * at `lba`. Every buffer has to be a whole number of sectors.
+     */
+    Span<const Span<uint8_t>> buffers = {};
+
+    /**
+     * Called once the request is done, possibly from an interrupt
+     * handler. Optional.
+     */
+    Callback on_complete = nullptr;
+    void* context = nullptr; // For the callback.
+
+    /**
+     * Set before completion, less than the size of
+     * the buffers if the disk failed or ended part way.
+     */
+    size_t bytes_transferred = 0;
+
+    /**
+     * Return true once the callback has returned, the request
+     * can then be reused or destroyed.
+     */
+    bool is_completed() const {
+        return __atomic_load_n(&completed, __ATOMIC_ACQUIRE);
+    }
+
+    size_t get_size() const;
+
+    /**
+     * Record the result and call the callback, for disks.
+     */
+    void complete(size_t transferred);
+
+    // Owned by the disk while the request is in flight.
+    bool completed = false;
+    const IDisk* disk = nullptr;
+    DiskRequest* next = nullptr;
+};
+
 /**
  * Generic disk.
  */
 class IDisk {
 public:
+    static constexpr size_t SECTOR_SIZE = 512;
+
     /**
      * Read sectors to the buffer until we are left without
      * space for a whole sector.
-     * Maximum 255 sectors.
+     * Return the number of bytes read, less than that
+     * if the disk failed or ended part way.
      */
-    virtual bool read(uint64_t lba, Span<uint8_t> buffer) const = 0;
+    virtual size_t read(uint64_t lba, Span<uint8_t> buffer) const = 0;
 
     /**
      * Write whole sectors from the buffer (if the buffer
      * has extra bytes in the end they are ignored).
-     * Maximum 255 sectors.
+     * Return the number of bytes written.
+     */
+    virtual size_t write(uint64_t lba, Span<uint8_t> buffer) const = 0;
+
+    /**
+     * Start `request`, it has to stay alive until it is completed.
+     * Return false if its buffers are not whole sectors.
+     *
+     * By default the request is done with `read` or `write`
+     * and completed before returning.
+     */
+    virtual bool submit(DiskRequest& request) const;
+
+    /**
+     * Make progress on submitted requests without blocking,
+     * needed for them to complete while interrupts are disabled.
+     */
+    virtual void poll() const {}
+
+    /**
+     * Block until `request` is completed.
+     */
+    virtual void wait(const DiskRequest& request) const;
+
+protected:
+    /**
+     * Check the buffers and get `request` ready to be submitted.
      */
-    virtual bool write(uint64_t lba, Span<uint8_t> buffer) const = 0;
+    bool prepare_request(DiskRequest& request) const;
 };
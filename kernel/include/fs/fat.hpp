@@ -43,3 +43,6 @@ namespace fat {
         friend class DirectoryParser;
     };
 }
+
+template <>
+inline constexpr bool IsTriviallyRelocatable<fat::DirEntry> = true;
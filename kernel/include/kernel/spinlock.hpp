@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <arch/i386/asm.hpp>
+
+/**
+ * Busy-waiting lock. Interrupts are disabled while it is held,
+ * so it can be shared with interrupt handlers.
+ */
+class Spinlock {
+public:
+    constexpr Spinlock() : locked(false), saved_flags(0) {}
+
+    Spinlock(const Spinlock& other) = delete;
+    Spinlock& operator=(const Spinlock& other) = delete;
+
+    void lock() {
+        uint32_t flags = save_and_disable_interrupts();
+        while (__atomic_exchange_n(&locked, true, __ATOMIC_ACQUIRE)) {
+            pause();
+        }
+        saved_flags = flags;
+    }
+
+    /**
+     * Take the lock if it is free, without waiting.
+     * Return true if it was taken.
+     */
+    bool try_lock() {
+        uint32_t flags = save_and_disable_interrupts();
+        if (__atomic_exchange_n(&locked, true, __ATOMIC_ACQUIRE)) {
+            restore_interrupts(flags);
+            return false;
+        }
+        saved_flags = flags;
+        return true;
+    }
+
+    void unlock() {
+        uint32_t flags = saved_flags;
+        __atomic_store_n(&locked, false, __ATOMIC_RELEASE);
+        restore_interrupts(flags);
+    }
+
+private:
+    bool locked;
+    uint32_t saved_flags;
+};
+
+/**
+ * Holds the lock until the end of the scope.
+ */
+class SpinlockGuard {
+public:
+    explicit SpinlockGuard(Spinlock& lock) : lock(lock) {
+        lock.lock();
+    }
+
+    SpinlockGuard(const SpinlockGuard& other) = delete;
+    SpinlockGuard& operator=(const SpinlockGuard& other) = delete;
+
+    ~SpinlockGuard() {
+        lock.unlock();
+    }
+
+private:
+    Spinlock& lock;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <util/array.hpp>
+#include <util/bitmap.hpp>
+#include <util/option.hpp>
+#include <util/span.hpp>
+
+/**
+ * Binary buddy allocator over abstract units (frames, pages...).
+ *
+ * A block of order `n` is 2^n units long and aligned to its size.
+ * For every order up to the instance's `max_order` there is a bitmap
+ * of free blocks, allocation and freeing take O(max_order * log n).
+ *
+ * The bookkeeping lives in caller-provided storage, so the allocator
+ * can be set up before the heap exists.
+ */
+class BuddyAllocator {
+public:
+    /**
+     * The biggest `max_order` an instance can have,
+     * big enough for a 1GiB block of pages.
+     */
+    static constexpr size_t MAX_ORDER = 18;
+
+    /**
+     * Return the number of words of storage needed to manage `unit_count`
+     * units in blocks of up to 2^max_order units.
+     */
+    static constexpr size_t get_storage_size(size_t unit_count, size_t max_order) {
+        size_t total = 0;
+        for (size_t order = 0; order <= max_order; order++) {
+            total += Bitmap::get_storage_size(unit_count >> order);
+        }
+        return total;
+    }
+
+    constexpr BuddyAllocator() : free_blocks(), unit_count(0), free_count(0), max_order(0) {}
+
+    /**
+     * Create an allocator with all units in use, handing out
+     * blocks of up to 2^max_order units.
+     * Use `free_range` to add available units.
+     */
+    BuddyAllocator(Span<uint32_t> storage, size_t unit_count, size_t max_order);
+
+    /**
+     * Allocate a block of 2^order units, return the first unit.
+     */
+    Option<size_t> allocate(size_t order);
+
+    /**
+     * Allocate `count` contiguous units below unit `limit`, the first
+     * one aligned to 2^alignment_order. The rest of the block is freed
+     * right away.
+     */
+    Option<size_t> allocate_range(
+        size_t count, size_t alignment_order = 0, size_t limit = SIZE_MAX);
+
+    /**
+     * Free a block previously returned by `allocate`.
+     */
+    void free(size_t unit, size_t order);
+
+    /**
+     * Free `count` units starting from `first`. The range does not
+     * have to be aligned or to have been allocated as one block,
+     * so this also frees ranges from `allocate_range`.
+     */
+    void free_range(size_t first, size_t count);
+
+    /**
+     * Return true if the unit is part of a free block.
+     */
+    bool is_free(size_t unit) const;
+
+    /**
+     * Return the size in units of the biggest free block,
+     * the most `allocate` can hand out right now. 0 if there is none.
+     */
+    size_t get_largest_free_block() const;
+
+    constexpr size_t get_unit_count() const {
+        return unit_count;
+    }
+
+    constexpr size_t get_free_count() const {
+        return free_count;
+    }
+
+private:
+    /**
+     * Allocate the lowest block of 2^order units whose first
+     * `needed` units end at or below `limit`.
+     */
+    Option<size_t> allocate_block(size_t order, size_t needed, size_t limit);
+
+    Array<Bitmap, MAX_ORDER + 1> free_blocks;
+    size_t unit_count;
+    size_t free_count;
+    size_t max_order;
+};
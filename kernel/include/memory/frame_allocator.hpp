@@ -1,16 +1,151 @@
 #pragma once
 
+#include <stdint.h>
 #include <stddef.h>
 #include <arch/i386/paging.hpp>
 #include <kernel/multiboot.h>
 #include <util/option.hpp>
 
 namespace frame_allocator {
+    /**
+     * The biggest block `allocate_frames` hands out is 2^MAX_ORDER frames (4MiB).
+     */
+    static constexpr size_t MAX_ORDER = 10;
+
+    /**
+     * Last address reachable by legacy ISA DMA.
+     */
+    static constexpr paging::PhysAddr ISA_DMA_MAX_ADDRESS = 0x00ff'ffff;
+
+    /**
+     * Last address reachable by 32-bit bus masters.
+     */
+    static constexpr paging::PhysAddr DMA32_MAX_ADDRESS = 0xffff'ffff;
+
+    /**
+     * Frames in the DMA zone that `allocate_frame(s)` leaves for
+     * `allocate_contiguous` (1MiB).
+     */
+    static constexpr size_t DMA_RESERVE_FRAMES = 256;
+
+    /**
+     * Single frame allocations and frees go through per-CPU caches
+     * of this many frames, which exchange MAGAZINE_BATCH frames
+     * with the zones at a time.
+     */
+    static constexpr size_t MAGAZINE_CAPACITY = 64;
+    static constexpr size_t MAGAZINE_BATCH = 32;
+
+    /**
+     * The idle loop keeps up to this many frames zeroed in advance (1MiB).
+     */
+    static constexpr size_t ZEROED_POOL_WATERMARK = 256;
+
+    /**
+     * Frames zeroed per `fill_zeroed_pool` call, so that the idle
+     * loop gets back to `hlt` quickly.
+     */
+    static constexpr size_t ZEROED_FILL_BATCH = 16;
+
+    struct CacheStats {
+        size_t hits; // Allocations served by a per-CPU cache.
+        size_t misses; // Allocations that had to refill the cache.
+        size_t drains; // Frees that had to return frames to the zones.
+        size_t zeroed_hits; // Zeroed frames taken from the pool.
+        size_t zeroed_misses; // Zeroed frames asked for while the pool was empty.
+    };
+
+    /**
+     * The most physical memory managed. The bookkeeping for all of it
+     * has to fit in the memory `boot.s` maps (it takes 1MiB for 16GiB).
+     */
+    static constexpr paging::PhysAddr MAX_MANAGED_ADDRESS = 0x3'ffff'ffff;
+
+    enum class Zone {
+        DMA, // Below 16MiB.
+        NORMAL, // Below 4GiB.
+        HIGH, // Only with PAE. Not reachable by 32-bit DMA.
+    };
+
+    static constexpr size_t ZONE_COUNT = 3;
+
+    struct ZoneStats {
+        size_t total_frames;
+        size_t free_frames; // Not counting the per-CPU caches.
+        size_t largest_free_block; // In frames, the most `allocate_contiguous` can get.
+    };
+
     void init(const multiboot_info_t& multiboot_info);
 
     Option<paging::PhysAddr> allocate_frame();
 
-    size_t get_total_memory();
+    /**
+     * Take a frame from the pool of zeroed frames. Return nothing if
+     * it is empty, the caller should then zero a frame from
+     * `allocate_frame` itself, through whatever mapping it has.
+     */
+    Option<paging::PhysAddr> take_zeroed_frame();
+
+    /**
+     * Zero up to ZEROED_FILL_BATCH frames into the pool, meant for
+     * the idle loop. Return true if the pool is still not full.
+     */
+    bool fill_zeroed_pool();
+
+    /**
+     * Allocate 2^order contiguous frames aligned to their size.
+     */
+    Option<paging::PhysAddr> allocate_frames(size_t order);
+
+    /**
+     * Allocate `frame_count` physically contiguous frames, the last
+     * byte of which is at or below `max_address`, with the first frame
+     * aligned to `alignment` bytes (a power of two).
+     * Meant for DMA buffers, may use the DMA zone reserve.
+     */
+    Option<paging::PhysAddr> allocate_contiguous(
+        size_t frame_count,
+        paging::PhysAddr max_address = DMA32_MAX_ADDRESS,
+        size_t alignment = paging::PAGE_SIZE);
+
+    void free_frame(paging::PhysAddr frame);
+
+    /**
+     * Free frames allocated with `allocate_frames`.
+     */
+    void free_frames(paging::PhysAddr first_frame, size_t order);
+
+    /**
+     * Free frames allocated with `allocate_contiguous`.
+     */
+    void free_contiguous(paging::PhysAddr first_frame, size_t frame_count);
+
+    /**
+     * Return the frames in the per-CPU caches to the zones,
+     * so that they can be merged into bigger blocks.
+     */
+    void drain_caches();
+
+    CacheStats get_cache_stats();
+
+    ZoneStats get_zone_stats(Zone zone);
+
+    /**
+     * Return the most memory that has been taken from the zones at once,
+     * frames held by the per-CPU caches included.
+     */
+    uint64_t get_peak_used_memory();
+
+    /**
+     * Return the end of the highest frame managed.
+     */
+    paging::PhysAddr get_memory_end();
+
+    uint64_t get_total_memory();
+
+    uint64_t get_total_memory(Zone zone);
+
+    uint64_t get_available_memory();
 
-    size_t get_available_memory();
+    uint64_t get_available_memory(Zone zone);
 }
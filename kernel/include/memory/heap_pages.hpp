@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <arch/i386/paging.hpp>
+
+namespace heap {
+    /**
+     * Set up the heap's virtual address space. Call after paging::init.
+     */
+    void init();
+
+    /**
+     * Set the high-water mark: the most memory the heap may have mapped.
+     */
+    void set_limit(size_t bytes);
+
+    size_t get_limit();
+
+    /**
+     * Return the memory currently mapped in the heap.
+     */
+    size_t get_mapped_memory();
+
+    /**
+     * Return the most memory the heap has had mapped at once.
+     */
+    size_t get_peak_mapped_memory();
+
+    /**
+     * Return the address space the heap has handed out, mapped or not.
+     */
+    size_t get_reserved_memory();
+
+    /**
+     * Return the address space still free in the heap area.
+     */
+    size_t get_free_address_space();
+
+    /**
+     * Return the biggest range that can still be allocated in one
+     * piece. Compared to `get_free_address_space`, it tells how
+     * fragmented the heap's address space is.
+     */
+    size_t get_largest_free_range();
+
+    /**
+     * Return idle pages kept by the allocators on top of the heap
+     * to the frame allocator. Return the number of pages freed.
+     */
+    size_t trim();
+
+    /**
+     * Map `count` contiguous pages in the heap area.
+     * Return nullptr on failure.
+     */
+    void* allocate_pages(size_t count);
+
+    /**
+     * Like `allocate_pages`, but the pages are zeroed,
+     * with pre-zeroed frames when there are any.
+     */
+    void* allocate_zeroed_pages(size_t count);
+
+    /**
+     * Reserve `count` contiguous pages in the heap area without mapping
+     * them. Each page gets a zeroed frame when first touched.
+     * Return nullptr on failure.
+     */
+    void* reserve_pages(size_t count);
+
+    /**
+     * Unmap pages returned by `allocate_pages`, `allocate_zeroed_pages`
+     * or `reserve_pages` and free their frames.
+     */
+    void free_pages(void* start, size_t count);
+
+    /**
+     * Map a zeroed frame at the faulting address if it is in a reserved
+     * heap range. Return false if the fault is not ours to handle.
+     */
+    bool handle_page_fault(paging::VirtAddr address);
+}
@@ -6,7 +6,7 @@
 #pragma once
 
 /**
- * Points to the beginning of the kernel in RAM.
+ * Points to the beginning of the kernel, in the physmap.
  */
 extern "C" int kernel_start;
 
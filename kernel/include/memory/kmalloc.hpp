@@ -0,0 +1,71 @@
+/**
+ * @file
+ * The kernel heap.
+ *
+ * Small allocations are served from one-page slabs, each split into
+ * objects of one size class, so allocating and freeing is O(1).
+ * Every CPU keeps a few free objects of each class in front of the
+ * slabs, so the slabs' lock is only taken once in a while.
+ * Allocations bigger than the biggest size class get their own pages.
+ *
+ * All of it can be used from interrupt handlers.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Allocate `size` bytes aligned to 16 bytes. Return nullptr on failure.
+ */
+void* kmalloc(size_t size);
+
+/**
+ * Allocate zeroed memory for `count` objects of `size` bytes.
+ */
+void* kcalloc(size_t count, size_t size);
+
+/**
+ * Resize the allocation, moving it if needed.
+ * krealloc(nullptr, size) is kmalloc(size),
+ * krealloc(ptr, 0) frees the pointer and returns nullptr.
+ */
+void* krealloc(void* ptr, size_t size);
+
+void kfree(void* ptr);
+
+struct KmallocStats {
+    size_t cache_hits; // Small allocations served by a per-CPU cache.
+    size_t cache_misses; // Small allocations that had to refill it.
+    size_t lock_acquisitions; // Times the slabs' lock was taken.
+    size_t lock_contentions; // Times it had to be waited for.
+    size_t slab_pages; // Pages split into small objects, free ones included.
+    size_t large_allocations; // Allocations with their own pages, since boot.
+    size_t large_in_use; // Those not freed yet.
+    size_t large_pages; // Pages they reserve, mapped or not.
+    size_t bytes_in_use; // Usable size of all live allocations.
+};
+
+struct KmallocClassStats {
+    size_t object_size;
+    size_t allocations; // Since boot.
+    size_t in_use; // Objects handed out and not freed yet.
+    size_t slabs; // One page each.
+};
+
+/**
+ * Give the objects in this CPU's cache back to the slabs and
+ * the empty slabs kept for reuse back to the heap.
+ * Return the number of pages freed.
+ */
+size_t kmalloc_trim();
+
+KmallocStats kmalloc_get_stats();
+
+size_t kmalloc_get_class_count();
+
+/**
+ * Return the counters of one size class, from the smallest (0)
+ * to the biggest (kmalloc_get_class_count() - 1).
+ */
+KmallocClassStats kmalloc_get_class_stats(size_t size_class);
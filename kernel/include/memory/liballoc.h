@@ -1,6 +1,9 @@
 /**
  * liballoc - a memory allocator for hobbyist operating systems.
  * Taken from: https://github.com/blanham/liballoc/tree/master.
+ *
+ * No longer the kernel heap (see memory/kmalloc.hpp), kept to compare
+ * against in the benchmarks.
  */
 
 #ifndef _LIBALLOC_H
@@ -25,7 +28,7 @@
 //typedef	unsigned long	uintptr_t;
 
 //This lets you prefix malloc and friends
-#define PREFIX(func)		k ## func
+#define PREFIX(func)		liballoc_k ## func
 
 #ifdef __cplusplus
 extern "C" {
@@ -78,6 +81,19 @@ extern void    *PREFIX(calloc)(size_t, size_t);		///< The standard function.
 extern void     PREFIX(free)(void *);					///< The standard function.
 
 
+/** The running totals liballoc keeps. */
+struct liballoc_stats
+{
+	unsigned long long allocated;	///< Memory acquired from the system.
+	unsigned long long inuse;		///< Memory malloc'ed.
+	long long warnings;
+	long long errors;
+	long long possible_overruns;
+};
+
+extern void     PREFIX(get_stats)(struct liballoc_stats *);	///< Take a snapshot of the totals.
+
+
 #ifdef __cplusplus
 }
 #endif
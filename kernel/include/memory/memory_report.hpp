@@ -0,0 +1,9 @@
+#pragma once
+
+namespace memory_report {
+    /**
+     * Print the counters of the frame allocator, the heap, kmalloc
+     * and liballoc, with how fragmented the free memory is.
+     */
+    void print();
+}
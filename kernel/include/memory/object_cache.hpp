@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <arch/i386/paging.hpp>
+#include <kernel/spinlock.hpp>
+#include <util/memory.hpp>
+#include <util/util.hpp>
+
+/**
+ * Type-erased part of ObjectCache.
+ */
+class ObjectCacheBase {
+public:
+    using ObjectCallback = void (*)(void* object);
+
+    /**
+     * Objects bigger than this should come from kmalloc,
+     * at least eight of them have to fit in a slab.
+     */
+    static constexpr size_t MAX_OBJECT_SIZE = paging::PAGE_SIZE / 8;
+
+    ObjectCacheBase(const ObjectCacheBase& other) = delete;
+    ObjectCacheBase& operator=(const ObjectCacheBase& other) = delete;
+
+    /**
+     * Free the pages of all empty slabs. Return the number of pages freed.
+     */
+    size_t reclaim();
+
+    /**
+     * Reclaim empty slabs in every cache, called when memory is low.
+     * Caches whose lock is held, like the one whose slab allocation
+     * ran out of memory, are skipped. Return the number of pages freed.
+     */
+    static size_t reclaim_all();
+
+    const char* get_name() const {
+        return name;
+    }
+
+    size_t get_slab_count() const {
+        return slab_count;
+    }
+
+    size_t get_used_count() const {
+        return used_count;
+    }
+
+protected:
+    struct Slab;
+
+    constexpr ObjectCacheBase(
+        const char* name, size_t object_size, size_t object_alignment,
+        ObjectCallback construct, ObjectCallback destroy)
+        : name(name),
+          object_size(align_up(object_size, object_alignment)),
+          object_alignment(object_alignment),
+          construct(construct), destroy(destroy),
+          partial(nullptr), full(nullptr), empty(nullptr),
+          slab_count(0), used_count(0),
+          next_cache(nullptr), registered(false), lock() {}
+
+    void* allocate_object();
+    void free_object(void* object);
+
+private:
+    static constexpr size_t align_up(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static void link(Slab*& list, Slab* slab);
+    static void unlink(Slab*& list, Slab* slab);
+
+    Slab* create_slab();
+    void destroy_slab(Slab* slab);
+
+    /**
+     * Call with `lock` held.
+     */
+    size_t reclaim_locked();
+
+    const char* name;
+    size_t object_size;
+    size_t object_alignment;
+    ObjectCallback construct;
+    ObjectCallback destroy;
+
+    Slab* partial;
+    Slab* full;
+    Slab* empty;
+
+    size_t slab_count;
+    size_t used_count;
+
+    // Caches register in the list of caches to reclaim when
+    // they create their first slab, they have no constructors to run.
+    // Protected by the lock of the list.
+    ObjectCacheBase* next_cache;
+    bool registered;
+
+    /**
+     * Protects the slab lists and counts. Taken before the heap's
+     * page lock, object constructors and destructors run with it held.
+     */
+    Spinlock lock;
+};
+
+/**
+ * Slab cache for objects of type T.
+ *
+ * Objects are constructed when their slab is created and destroyed
+ * when it is reclaimed. In between, `allocate` hands out objects in
+ * the state they were freed in, so they have to be returned to
+ * `free` in a state equivalent to a freshly constructed one. Expensive
+ * initialization (like a buffer) is then paid once per object, not
+ * once per allocation.
+ *
+ * Only objects allocated one at a time benefit, objects stored by
+ * value in a container (like fat::DirEntry in a Vector) are part of
+ * the container's single allocation.
+ *
+ * Every cache has an interrupt-disabling spinlock, so `allocate` and
+ * `free` can be called from interrupt handlers. Constructors and
+ * destructors run with that lock held and must not use the same cache.
+ * The heap reclaims empty slabs when it runs out of memory, it skips
+ * the caches whose lock is taken instead of waiting for them.
+ *
+ * Usually a static, as in:
+ * static ObjectCache<Buffer> buffer_cache("buffer");
+ */
+template <typename T>
+class ObjectCache : public ObjectCacheBase {
+public:
+    static_assert(sizeof(T) <= MAX_OBJECT_SIZE, "Use kmalloc for big objects");
+
+    constexpr ObjectCache(const char* name)
+        : ObjectCacheBase(
+            name, sizeof(T), alignof(T),
+            __is_trivially_constructible(T) ? nullptr : construct_object,
+            IsTriviallyDestructible<T> ? nullptr : destroy_object) {}
+
+    /**
+     * Return an object, nullptr if out of memory.
+     */
+    T* allocate() {
+        return static_cast<T*>(allocate_object());
+    }
+
+    void free(T* object) {
+        free_object(object);
+    }
+
+private:
+    static void construct_object(void* object) {
+        new (object) T();
+    }
+
+    static void destroy_object(void* object) {
+        static_cast<T*>(object)->~T();
+    }
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <arch/i386/paging.hpp>
+#include <memory/buddy_allocator.hpp>
+#include <util/option.hpp>
+#include <util/span.hpp>
+
+/**
+ * Hands out page-aligned ranges of a window of virtual address space.
+ *
+ * Ranges are tracked by a buddy allocator over the window's pages,
+ * so allocating and freeing take O(log n) and do not look at the page
+ * tables. A single range is at most 2^max_order pages.
+ */
+class VirtualRangeAllocator {
+public:
+    /**
+     * Return the number of words of storage needed for a window of
+     * `page_count` pages, with ranges of up to 2^max_order pages.
+     */
+    static constexpr size_t get_storage_size(size_t page_count, size_t max_order) {
+        return BuddyAllocator::get_storage_size(page_count, max_order);
+    }
+
+    constexpr VirtualRangeAllocator() : pages(), start(0), end(0) {}
+
+    /**
+     * Create an allocator with the whole [start; end) window free.
+     */
+    VirtualRangeAllocator(
+        Span<uint32_t> storage,
+        paging::VirtAddr start,
+        paging::VirtAddr end,
+        size_t max_order);
+
+    /**
+     * Reserve `page_count` pages, the first one aligned to `alignment` bytes.
+     */
+    Option<paging::VirtAddr> allocate(size_t page_count, size_t alignment = paging::PAGE_SIZE);
+
+    /**
+     * Release a range, or a part of one, returned by `allocate`.
+     */
+    void free(paging::VirtAddr range_start, size_t page_count);
+
+    /**
+     * Return true if the page containing `address` is in an allocated range.
+     */
+    bool is_allocated(paging::VirtAddr address) const;
+
+    constexpr bool contains(paging::VirtAddr address) const {
+        return address >= start && address < end;
+    }
+
+    constexpr paging::VirtAddr get_start() const {
+        return start;
+    }
+
+    constexpr paging::VirtAddr get_end() const {
+        return end;
+    }
+
+    constexpr size_t get_free_pages() const {
+        return pages.get_free_count();
+    }
+
+    /**
+     * Return the size of the biggest range that can be allocated, in pages.
+     */
+    size_t get_largest_free_range() const {
+        return pages.get_largest_free_block();
+    }
+
+private:
+    BuddyAllocator pages;
+    paging::VirtAddr start;
+    paging::VirtAddr end;
+};
@@ -12,12 +12,23 @@ template <typename T, size_t SIZE>
 struct Array {
 public:
     constexpr const T& operator[](size_t index) const {
-        ASSERT(index < SIZE);
+        ASSERT_IN_BOUNDS(index, SIZE);
         return data[index];
     }
 
     constexpr T& operator[](size_t index) {
-        ASSERT(index < SIZE);
+        ASSERT_IN_BOUNDS(index, SIZE);
+        return data[index];
+    }
+
+    /**
+     * Like operator[], but the index is never checked.
+     */
+    constexpr const T& unchecked_at(size_t index) const {
+        return data[index];
+    }
+
+    constexpr T& unchecked_at(size_t index) {
         return data[index];
     }
 
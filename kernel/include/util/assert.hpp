@@ -7,3 +7,19 @@ void assertion_failed(const char* file, int line, const char* condition);
     if (!static_cast<bool>(condition)) [[unlikely]] { \
         assertion_failed(__FILE__, __LINE__, #condition); \
     }
+
+#ifndef LOS_BOUNDS_CHECKS
+#define LOS_BOUNDS_CHECKS 1
+#endif
+
+/**
+ * Whether the containers' operator[] checks the index, set by the
+ * bounds_checks build option. Hot loops can check the range once
+ * and use `unchecked_at` instead.
+ */
+inline constexpr bool BOUNDS_CHECKS = LOS_BOUNDS_CHECKS;
+
+#define ASSERT_IN_BOUNDS(index, size) \
+    if constexpr (BOUNDS_CHECKS) { \
+        ASSERT((index) < (size)); \
+    }
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <util/array.hpp>
+#include <util/assert.hpp>
+#include <util/option.hpp>
+#include <util/span.hpp>
+
+/**
+ * Bitmap over caller-provided storage.
+ *
+ * Every level above the first has a bit per word of the level below,
+ * set when that word has any bits set. This makes finding a set bit
+ * take one word read per level, that is O(log n).
+ */
+class Bitmap {
+public:
+    static constexpr size_t BITS_PER_WORD = 32;
+
+    /**
+     * Enough for 2^32 bits.
+     */
+    static constexpr size_t MAX_LEVELS = 7;
+
+    /**
+     * Return the number of words of storage needed for `bit_count` bits.
+     */
+    static constexpr size_t get_storage_size(size_t bit_count) {
+        size_t total = 0;
+        size_t words = get_word_count(bit_count);
+        for (;;) {
+            total += words;
+            if (words <= 1) break;
+            words = get_word_count(words);
+        }
+        return total;
+    }
+
+    constexpr Bitmap() : levels(), level_count(0), bit_count(0) {}
+
+    /**
+     * Create a bitmap with all bits cleared. `storage` must be
+     * at least `get_storage_size(bit_count)` words long.
+     */
+    Bitmap(Span<uint32_t> storage, size_t bit_count)
+        : levels(), level_count(0), bit_count(bit_count)
+    {
+        ASSERT(storage.get_size() >= get_storage_size(bit_count));
+        if (bit_count == 0) return;
+
+        size_t used = 0;
+        size_t words = get_word_count(bit_count);
+        for (;;) {
+            ASSERT(level_count < MAX_LEVELS);
+            levels[level_count] = { storage.start + used, words };
+            level_count++;
+            used += words;
+
+            if (words <= 1) break;
+            words = get_word_count(words);
+        }
+
+        for (size_t i = 0; i < used; i++) {
+            storage.start[i] = 0;
+        }
+    }
+
+    bool get(size_t index) const {
+        ASSERT(index < bit_count);
+        return (levels[0].start[index / BITS_PER_WORD] >> (index % BITS_PER_WORD)) & 1;
+    }
+
+    void set(size_t index) {
+        ASSERT(index < bit_count);
+        for (size_t level = 0; level < level_count; level++) {
+            uint32_t& word = levels[level].start[index / BITS_PER_WORD];
+            bool was_empty = word == 0;
+            word |= 1u << (index % BITS_PER_WORD);
+
+            // The levels above already know about this word.
+            if (!was_empty) break;
+            index /= BITS_PER_WORD;
+        }
+    }
+
+    void clear(size_t index) {
+        ASSERT(index < bit_count);
+        for (size_t level = 0; level < level_count; level++) {
+            uint32_t& word = levels[level].start[index / BITS_PER_WORD];
+            word &= ~(1u << (index % BITS_PER_WORD));
+
+            // The word still has bits set, the levels above stay the same.
+            if (word != 0) break;
+            index /= BITS_PER_WORD;
+        }
+    }
+
+    /**
+     * Return the index of the lowest set bit.
+     */
+    Option<size_t> find_first_set() const {
+        if (level_count == 0 || levels[level_count - 1].start[0] == 0) {
+            return {};
+        }
+
+        size_t index = 0;
+        for (size_t level = level_count; level > 0; level--) {
+            uint32_t word = levels[level - 1].start[index];
+            index = index * BITS_PER_WORD + __builtin_ctz(word);
+        }
+        return index;
+    }
+
+    constexpr size_t get_size() const {
+        return bit_count;
+    }
+
+private:
+    static constexpr size_t get_word_count(size_t bit_count) {
+        return (bit_count + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    }
+
+    Array<Span<uint32_t>, MAX_LEVELS> levels;
+    size_t level_count;
+    size_t bit_count;
+};
@@ -10,7 +10,7 @@ Bit manipulation functions.
  */
 template <typename T>
 constexpr bool get_bit(T flags, unsigned bit) {
-    return (flags & (1 << bit)) != 0;
+    return (flags & (T(1) << bit)) != 0;
 }
 
 /**
@@ -19,7 +19,7 @@ constexpr bool get_bit(T flags, unsigned bit) {
  */
 template <typename T>
 constexpr T set_bit(T flags, unsigned bit) {
-    return flags | (1 << bit);
+    return flags | (T(1) << bit);
 }
 
 /**
@@ -28,7 +28,7 @@ constexpr T set_bit(T flags, unsigned bit) {
  */
 template <typename T>
 constexpr T unset_bit(T flags, unsigned bit) {
-    return flags & ~(1 << bit);
+    return flags & ~(T(1) << bit);
 }
 
 /**
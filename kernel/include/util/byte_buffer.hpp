@@ -54,12 +54,23 @@ public:
     }
 
     constexpr const uint8_t& operator[](size_t index) const {
-        ASSERT(index < size);
+        ASSERT_IN_BOUNDS(index, size);
         return data[index];
     }
 
     constexpr uint8_t& operator[](size_t index) {
-        ASSERT(index < size);
+        ASSERT_IN_BOUNDS(index, size);
+        return data[index];
+    }
+
+    /**
+     * Like operator[], but the index is never checked.
+     */
+    constexpr const uint8_t& unchecked_at(size_t index) const {
+        return data[index];
+    }
+
+    constexpr uint8_t& unchecked_at(size_t index) {
         return data[index];
     }
 
@@ -95,12 +95,23 @@ public:
     }
 
     const T& operator[](size_t index) const {
-        ASSERT(index < count);
+        ASSERT_IN_BOUNDS(index, count);
         return items[index];
     }
 
     T& operator[](size_t index) {
-        ASSERT(index < count);
+        ASSERT_IN_BOUNDS(index, count);
+        return items[index];
+    }
+
+    /**
+     * Like operator[], but the index is never checked.
+     */
+    const T& unchecked_at(size_t index) const {
+        return items[index];
+    }
+
+    T& unchecked_at(size_t index) {
         return items[index];
     }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <util/util.hpp>
 
 template <typename T>
@@ -11,3 +12,14 @@ template <typename T>
 inline T min(T a, IdentityType<T> b) {
     return a < b ? a : b;
 }
+
+/**
+ * Return the smallest n such that 2^n >= value.
+ */
+constexpr unsigned ceil_log2(size_t value) {
+    unsigned result = 0;
+    while ((static_cast<size_t>(1) << result) < value) {
+        result++;
+    }
+    return result;
+}
@@ -5,6 +5,7 @@
 #pragma once
 
 #include <stddef.h>
+#include <util/math.hpp>
 #include <util/span.hpp>
 
 /* Needed to be able to use placement new. (https://wiki.osdev.org/C%2B%2B#Placement_New) */
@@ -13,6 +14,19 @@ inline void* operator new[](size_t, void* p) { return p; }
 inline void operator delete(void*, void*) {}
 inline void operator delete[](void*, void*) {}
 
+extern "C" {
+    void* memcpy(void* dst, const void* src, size_t size);
+    void* memmove(void* dst, const void* src, size_t size);
+    void* memset(void* dst, int value, size_t size);
+    int memcmp(const void* lhs, const void* rhs, size_t size);
+}
+
+/**
+ * Pick the fastest variants of the functions above
+ * for the CPU. They work before this is called too.
+ */
+void init_memory_functions();
+
 /**
  * Copy `size` objects from `src` to `dst` using
  * the copy constructor.
@@ -21,6 +35,11 @@ template <typename T>
 void copy_construct(Span<T> dst, Span<const T> src) requires(IsCopyConstructible<T>) {
     ASSERT(dst.get_size() == src.get_size());
 
+    if constexpr (IsTriviallyCopyConstructible<T>) {
+        memcpy(dst.begin(), src.begin(), src.get_size() * sizeof(T));
+        return;
+    }
+
     // To avoid bound checks (we have the assertion above).
     auto dst_iter = dst.begin();
     for (const auto& elem : src) {
@@ -37,6 +56,11 @@ template <typename T>
 void copy_assign(Span<T> dst, Span<const T> src) requires(IsCopyConstructible<T>) {
     ASSERT(dst.get_size() == src.get_size());
 
+    if constexpr (IsTriviallyCopyAssignable<T>) {
+        memcpy(dst.begin(), src.begin(), src.get_size() * sizeof(T));
+        return;
+    }
+
     // To avoid bound checks (we have the assertion above).
     auto dst_iter = dst.begin();
     for (const auto& elem : src) {
@@ -45,11 +69,43 @@ void copy_assign(Span<T> dst, Span<const T> src) requires(IsCopyConstructible<T>
     }
 }
 
+/**
+ * Move `count` objects from `src` to the uninitialized `dst`,
+ * destroying the originals. The ranges must not overlap.
+ */
+template <typename T>
+void relocate(T* dst, T* src, size_t count) {
+    if constexpr (IsTriviallyRelocatable<T>) {
+        memcpy(dst, src, count * sizeof(T));
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        new (&dst[i]) T(move(src[i]));
+        src[i].~T();
+    }
+}
+
 /**
  * Compare two spans alphabetically.
  */
 template <typename T>
 int compare(Span<const T> lhs, Span<const T> rhs) {
+    if constexpr (__is_same(T, uint8_t)) {
+        size_t common = min(lhs.get_size(), rhs.get_size());
+        if (int result = memcmp(lhs.begin(), rhs.begin(), common); result != 0) {
+            return result;
+        }
+
+        if (lhs.get_size() > common) {
+            return 1;
+        } else if (rhs.get_size() > common) {
+            return -1;
+        } else {
+            return 0;
+        }
+    }
+
     auto lhs_iter = lhs.begin();
     auto rhs_iter = rhs.begin();
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <util/assert.hpp>
+#include <util/memory.hpp>
 #include <util/util.hpp>
 
 /*
@@ -9,12 +9,23 @@ template <typename T>
 struct Span {
 public:
     constexpr const T& operator[](size_t index) const {
-        ASSERT(index < size);
+        ASSERT_IN_BOUNDS(index, size);
         return start[index];
     }
 
     constexpr T& operator[](size_t index) {
-        ASSERT(index < size);
+        ASSERT_IN_BOUNDS(index, size);
+        return start[index];
+    }
+
+    /**
+     * Like operator[], but the index is never checked.
+     */
+    constexpr const T& unchecked_at(size_t index) const {
+        return start[index];
+    }
+
+    constexpr T& unchecked_at(size_t index) {
         return start[index];
     }
 
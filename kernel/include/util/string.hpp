@@ -1,48 +1,187 @@
 #pragma once
 
-#include <util/vector.hpp>
+#include <stddef.h>
+#include <memory/kmalloc.hpp>
+#include <util/array.hpp>
+#include <util/math.hpp>
+#include <util/memory.hpp>
 #include <util/string_view.hpp>
 
 /**
- * Heap-allocated char vector.
+ * Growable char string. Not null-terminated.
+ *
+ * Strings of up to INLINE_CAPACITY chars are kept in the object
+ * itself, only longer ones are put on the heap.
  */
 class String {
 public:
-    explicit String(StringView view)
-        : chars(view) {}
+    /**
+     * Enough for 8.3 names and most long file names.
+     */
+    static constexpr size_t INLINE_CAPACITY = 24;
 
-    String() : chars() {}
+    constexpr String()
+        : size(0), capacity(INLINE_CAPACITY), inline_chars() {}
+
+    /**
+     * Copy the view in one go, allocating at most once.
+     */
+    explicit String(StringView view) : String() {
+        append(view);
+    }
+
+    String(const String& other) : String() {
+        append(other);
+    }
+
+    String& operator=(const String& other) {
+        if (this != &other) {
+            size = 0;
+            append(other);
+        }
+        return *this;
+    }
+
+    String(String&& other) : String() {
+        take(other);
+    }
+
+    String& operator=(String&& other) {
+        if (this != &other) {
+            release();
+            take(other);
+        }
+        return *this;
+    }
+
+    ~String() {
+        release();
+    }
 
     constexpr operator StringView() const {
-        return { begin(), get_size() };
+        return { begin(), size };
     }
 
     constexpr char& operator[](size_t index) {
-        return chars[index];
+        ASSERT_IN_BOUNDS(index, size);
+        return begin()[index];
     }
 
     constexpr const char& operator[](size_t index) const {
-        return chars[index];
+        ASSERT_IN_BOUNDS(index, size);
+        return begin()[index];
+    }
+
+    /**
+     * Like operator[], but the index is never checked.
+     */
+    constexpr char& unchecked_at(size_t index) {
+        return begin()[index];
+    }
+
+    constexpr const char& unchecked_at(size_t index) const {
+        return begin()[index];
     }
 
-    constexpr operator Span<char>() { return chars; }
+    constexpr operator Span<char>() { return { begin(), size }; }
 
-    constexpr operator Span<const char>() const { return chars; }
+    constexpr operator Span<const char>() const { return { begin(), size }; }
 
     constexpr size_t get_size() const {
-        return chars.get_size();
+        return size;
+    }
+
+    constexpr size_t get_capacity() const {
+        return capacity;
+    }
+
+    /**
+     * Make room for `new_capacity` chars, so that appending
+     * up to that many does not allocate.
+     */
+    void reserve(size_t new_capacity) {
+        if (new_capacity > capacity) {
+            grow(new_capacity);
+        }
     }
 
     void push_back(char ch) {
-        chars.push_back(ch);
+        if (size == capacity) {
+            grow(max(size + 1, capacity * 2));
+        }
+        begin()[size] = ch;
+        size++;
     }
 
-    constexpr char* begin() { return chars.begin(); }
-    constexpr char* end() { return chars.end(); }
+    /**
+     * Append the chars of `view`, which must not point into this string.
+     */
+    void append(StringView view) {
+        size_t new_size = size + view.get_size();
+        if (new_size > capacity) {
+            grow(max(new_size, capacity * 2));
+        }
+        memcpy(begin() + size, view.begin(), view.get_size());
+        size = new_size;
+    }
+
+    constexpr char* begin() { return is_inline() ? inline_chars.begin() : heap_chars; }
+    constexpr char* end() { return begin() + size; }
 
-    constexpr const char* begin() const { return chars.begin(); }
-    constexpr const char* end() const { return chars.end(); }
+    constexpr const char* begin() const { return is_inline() ? inline_chars.begin() : heap_chars; }
+    constexpr const char* end() const { return begin() + size; }
 
 private:
-    Vector<char> chars;
+    constexpr bool is_inline() const {
+        return capacity == INLINE_CAPACITY;
+    }
+
+    /**
+     * Move the chars to a heap buffer of `new_capacity` chars.
+     */
+    void grow(size_t new_capacity) {
+        if (is_inline()) {
+            auto chars = static_cast<char*>(kmalloc(new_capacity));
+            memcpy(chars, inline_chars.begin(), size);
+            heap_chars = chars;
+        } else {
+            heap_chars = static_cast<char*>(krealloc(heap_chars, new_capacity));
+        }
+        capacity = new_capacity;
+    }
+
+    void release() {
+        if (!is_inline()) {
+            kfree(heap_chars);
+        }
+        size = 0;
+        capacity = INLINE_CAPACITY;
+    }
+
+    /**
+     * Take the chars of `other`, leaving it empty.
+     * Call with no heap buffer of our own.
+     */
+    void take(String& other) {
+        size = other.size;
+        capacity = other.capacity;
+        if (other.is_inline()) {
+            memcpy(inline_chars.begin(), other.inline_chars.begin(), other.size);
+        } else {
+            heap_chars = other.heap_chars;
+        }
+
+        other.size = 0;
+        other.capacity = INLINE_CAPACITY;
+    }
+
+    size_t size;
+    size_t capacity; // INLINE_CAPACITY while the chars are inline.
+    union {
+        Array<char, INLINE_CAPACITY> inline_chars;
+        char* heap_chars;
+    };
 };
+
+template <>
+inline constexpr bool IsTriviallyRelocatable<String> = true;
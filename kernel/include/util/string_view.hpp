@@ -20,7 +20,14 @@ public:
         : start(nullptr), size(0) {}
 
     constexpr char operator[](size_t index) const {
-        ASSERT(index < size);
+        ASSERT_IN_BOUNDS(index, size);
+        return start[index];
+    }
+
+    /**
+     * Like operator[], but the index is never checked.
+     */
+    constexpr char unchecked_at(size_t index) const {
         return start[index];
     }
 
@@ -87,6 +87,15 @@ inline constexpr bool IsTriviallyMoveAssignable = __is_trivially_assignable(T&,
 template <typename T>
 inline constexpr bool IsTriviallyDestructible = __has_trivial_destructor(T);
 
+/**
+ * true if an object can be moved to another address with memcpy,
+ * leaving nothing to destroy at the old one. Specialize it for types
+ * with move constructors that just copy pointers and reset the source.
+ */
+template <typename T>
+inline constexpr bool IsTriviallyRelocatable =
+    IsTriviallyMoveConstructible<T> && IsTriviallyDestructible<T>;
+
 template<typename T>
 inline constexpr bool IsCopyConstructible = __is_constructible(T, const T&);
 
@@ -4,19 +4,21 @@
 #include <util/memory.hpp>
 #include <util/math.hpp>
 #include <util/util.hpp>
-#include <memory/liballoc.h>
+#include <memory/kmalloc.hpp>
 
+/**
+ * Heap-allocated dynamic array.
+ *
+ * Items are moved to a bigger buffer as it grows, with krealloc if
+ * they are trivially relocatable, one by one otherwise.
+ */
 template <typename T>
 class Vector {
 public:
-    explicit Vector(size_t initial_capacity) {
-        capacity = initial_capacity;
-        if (initial_capacity != 0) {
-            items = reinterpret_cast<T*>(kmalloc(sizeof(T) * initial_capacity));
-        } else {
-            items = nullptr;
-        }
-        count = 0;
+    explicit Vector(size_t initial_capacity)
+        : items(nullptr), count(0), capacity(0)
+    {
+        reserve(initial_capacity);
     }
 
     Vector() : Vector(0) {}
@@ -29,19 +31,20 @@ public:
     }
 
     Vector(const Vector& other)
-        : items(reinterpret_cast<T*>(kmalloc(sizeof(T) * other.capacity))),
-          count(other.count), capacity(other.capacity)
+        : Vector(other.count)
     {
+        count = other.count;
         copy_construct<T>(*this, other);
     }
 
     Vector& operator=(const Vector& other) {
-        destroy();
+        if (this == &other) {
+            return *this;
+        }
 
-        items = reinterpret_cast<T*>(kmalloc(sizeof(T) * other.capacity));
+        clear();
+        reserve(other.count);
         count = other.count;
-        capacity = other.capacity;
-
         copy_construct<T>(*this, other);
 
         return *this;
@@ -56,6 +59,10 @@ public:
     }
 
     Vector& operator=(Vector&& other) {
+        if (this == &other) {
+            return *this;
+        }
+
         destroy();
 
         items = other.items;
@@ -74,36 +81,119 @@ public:
     }
 
     /**
-     * Append `value` to the end of the array using the copy constructor.
+     * Make room for `new_capacity` items, so that appending
+     * up to that many does not reallocate.
      */
-    void push_back(const T& value) {
+    void reserve(size_t new_capacity) {
+        if (new_capacity > capacity) {
+            reallocate(new_capacity);
+        }
+    }
+
+    /**
+     * Give back the memory not used by the items.
+     */
+    void shrink_to_fit() {
+        if (count < capacity) {
+            reallocate(count);
+        }
+    }
+
+    /**
+     * Construct an item at the end of the array from `args`.
+     */
+    template <typename... Args>
+    T& emplace_back(Args&&... args) {
         if (count == capacity) {
             grow();
         }
 
-        new (&items[count]) T(value);
+        T* item = new (&items[count]) T(forward<Args>(args)...);
         count++;
+        return *item;
+    }
+
+    /**
+     * Append `value` to the end of the array using the copy constructor.
+     */
+    void push_back(const T& value) {
+        emplace_back(value);
     }
 
     /**
      * Append `value` to the end of the array using the move constructor.
      */
     void push_back(T&& value) {
-        if (count == capacity) {
-            grow();
+        emplace_back(move(value));
+    }
+
+    void pop_back() {
+        ASSERT(count > 0);
+        count--;
+        items[count].~T();
+    }
+
+    /**
+     * Destroy all items, keeping the memory.
+     */
+    void clear() {
+        destroy_items(0);
+        count = 0;
+    }
+
+    /**
+     * Destroy the items past `new_size` or append
+     * default-constructed ones up to it.
+     */
+    void resize(size_t new_size) {
+        if (new_size < count) {
+            destroy_items(new_size);
+            count = new_size;
+            return;
         }
 
-        new (&items[count]) T(move(value));
-        count++;
+        reserve(new_size);
+        while (count < new_size) {
+            new (&items[count]) T();
+            count++;
+        }
+    }
+
+    /**
+     * Like `resize`, but new items are copies of `value`.
+     */
+    void resize(size_t new_size, const T& value) {
+        if (new_size < count) {
+            destroy_items(new_size);
+            count = new_size;
+            return;
+        }
+
+        reserve(new_size);
+        while (count < new_size) {
+            new (&items[count]) T(value);
+            count++;
+        }
     }
 
     constexpr const T& operator[](size_t index) const {
-        ASSERT(index < count);
+        ASSERT_IN_BOUNDS(index, count);
         return items[index];
     }
 
     constexpr T& operator[](size_t index) {
-        ASSERT(index < count);
+        ASSERT_IN_BOUNDS(index, count);
+        return items[index];
+    }
+
+    /**
+     * Like operator[], but the index is never checked.
+     */
+    constexpr const T& unchecked_at(size_t index) const {
+        return items[index];
+    }
+
+    constexpr T& unchecked_at(size_t index) {
         return items[index];
     }
 
@@ -111,6 +201,10 @@ public:
         return count;
     }
 
+    constexpr size_t get_capacity() const {
+        return capacity;
+    }
+
     constexpr T* begin() { return items; }
     constexpr T* end() { return items + count; }
 
@@ -123,19 +217,45 @@ public:
 
 private:
     void grow() {
-        capacity = max(8, capacity * 2);
-        items = reinterpret_cast<T*>(krealloc(
-            reinterpret_cast<void*>(items), capacity * sizeof(T)));
+        reallocate(max(8, capacity * 2));
     }
 
-    void destroy() {
-        kfree(items);
+    /**
+     * Move the items to a buffer of `new_capacity` items.
+     */
+    void reallocate(size_t new_capacity) {
+        ASSERT(new_capacity >= count);
+
+        // krealloc keeps the block when shrinking, the memory
+        // is only given back by moving to a smaller one.
+        if (new_capacity == 0) {
+            kfree(items);
+            items = nullptr;
+        } else if (IsTriviallyRelocatable<T> && new_capacity > capacity) {
+            items = reinterpret_cast<T*>(krealloc(
+                reinterpret_cast<void*>(items), new_capacity * sizeof(T)));
+        } else {
+            auto new_items = reinterpret_cast<T*>(kmalloc(new_capacity * sizeof(T)));
+            relocate(new_items, items, count);
+            kfree(items);
+            items = new_items;
+        }
+        capacity = new_capacity;
     }
 
-    void destroy() requires (!IsTriviallyDestructible<T>) {
-        for (size_t i = 0; i < count; i++) {
-            items[i].~T();
+    /**
+     * Destroy the items from `first` to the end.
+     */
+    void destroy_items(size_t first) {
+        if constexpr (!IsTriviallyDestructible<T>) {
+            for (size_t i = first; i < count; i++) {
+                items[i].~T();
+            }
         }
+    }
+
+    void destroy() {
+        destroy_items(0);
         kfree(items);
     }
 
@@ -143,3 +263,6 @@ private:
     size_t count;
     size_t capacity;
 };
+
+template <typename T>
+inline constexpr bool IsTriviallyRelocatable<Vector<T>> = true;
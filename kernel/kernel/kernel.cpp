@@ -10,15 +10,44 @@
 #include <arch/i386/terminal.hpp>
 #include <arch/i386/pci.hpp>
 #include <arch/i386/ide.hpp>
+#include <arch/i386/paging.hpp>
 #include <kernel/log.hpp>
 #include <kernel/print.hpp>
 #include <kernel/kpanic.hpp>
 #include <kernel/multiboot.h>
+#include <bench/bench.hpp>
 #include <fs/fat.hpp>
 #include <memory/frame_allocator.hpp>
+#include <memory/heap_pages.hpp>
+#include <memory/memory_report.hpp>
+#include <util/bits.hpp>
+#include <util/memory.hpp>
+
+/**
+ * Return true if the kernel command line contains `option`.
+ */
+static bool has_boot_option(const multiboot_info_t& info, StringView option) {
+    bool cmdline_valid = get_bit(info.flags, 2);
+    if (!cmdline_valid) {
+        return false;
+    }
+
+    auto cmdline = paging::to_virtual<const char>(info.cmdline);
+    for (size_t start = 0; cmdline[start]; start++) {
+        size_t i = 0;
+        while (i < option.get_size() && cmdline[start + i] == option[i]) {
+            i++;
+        }
+        if (i == option.get_size()) {
+            return true;
+        }
+    }
+    return false;
+}
 
 extern "C" [[noreturn]]
 void kmain(const multiboot_info_t& multiboot_info, uint32_t magic) {
+    init_memory_functions();
     terminal::clear();
 
     if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
@@ -31,6 +60,7 @@ void kmain(const multiboot_info_t& multiboot_info, uint32_t magic) {
 
     frame_allocator::init(multiboot_info);
     paging::init();
+    heap::init();
 
     println("Los ({}MiB RAM Available)",
         frame_allocator::get_total_memory() / 1024 / 1024);
@@ -100,11 +130,18 @@ void kmain(const multiboot_info_t& multiboot_info, uint32_t magic) {
         }
     };
 
+    if (has_boot_option(multiboot_info, "bench")) {
+        println("\nRunning benchmarks...");
+        bench::run_all();
+    }
+
     Option<const ps2::Device&> keyboard = ps2::find_device_with_type(0xab83);
     if (keyboard.has_value()) {
         keyboard->set_interrupt_handler(keyboard::irq_handler);
         keyboard::set_callback([](keyboard::KeyEventArgs args) {
-            if (!args.released && args.character) {
+            if (!args.released && args.key == keyboard::Key::F1) {
+                memory_report::print();
+            } else if (!args.released && args.character) {
                 terminal::putchar(args.character);
             }
         });
@@ -113,9 +150,15 @@ void kmain(const multiboot_info_t& multiboot_info, uint32_t magic) {
         pic::clear_mask(1);
         enable_interrupts();
 
-        println("\nYou can type\n");
+        println("\nYou can type, F1 prints a memory report\n");
     } else {
         println("\nNo keyboard.");
     }
-    for (;;) hlt();
+
+    // Idle loop, zero frames in advance while there is nothing else to do.
+    for (;;) {
+        if (!frame_allocator::fill_zeroed_pool()) {
+            hlt();
+        }
+    }
 }
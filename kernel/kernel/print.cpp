@@ -25,7 +25,7 @@ static void print_number_with_base(T value, int base) {
         value = -value;
     }
 
-    constexpr int BUF_SIZE = 18; // Enough for max uint64_t.
+    constexpr int BUF_SIZE = 20; // Enough for max uint64_t.
     Array<char, BUF_SIZE> buf;
     int buf_start = BUF_SIZE;
 
@@ -0,0 +1,136 @@
+#include <memory/buddy_allocator.hpp>
+
+#include <util/assert.hpp>
+#include <util/math.hpp>
+
+BuddyAllocator::BuddyAllocator(Span<uint32_t> storage, size_t unit_count, size_t max_order)
+    : free_blocks(), unit_count(unit_count), free_count(0), max_order(max_order)
+{
+    ASSERT(max_order <= MAX_ORDER);
+    ASSERT(storage.get_size() >= get_storage_size(unit_count, max_order));
+
+    size_t used = 0;
+    for (size_t order = 0; order <= max_order; order++) {
+        // Only whole blocks are tracked, the tail is never free.
+        size_t block_count = unit_count >> order;
+        size_t words = Bitmap::get_storage_size(block_count);
+
+        free_blocks[order] = Bitmap({ storage.start + used, words }, block_count);
+        used += words;
+    }
+}
+
+Option<size_t> BuddyAllocator::allocate(size_t order) {
+    return allocate_block(order, 1 << order, SIZE_MAX);
+}
+
+Option<size_t> BuddyAllocator::allocate_range(
+    size_t count, size_t alignment_order, size_t limit)
+{
+    ASSERT(count > 0);
+
+    size_t order = max(ceil_log2(count), alignment_order);
+    if (order > max_order) {
+        return {};
+    }
+
+    auto maybe_first = allocate_block(order, count, limit);
+    if (!maybe_first.has_value()) {
+        return {};
+    }
+
+    size_t first = maybe_first.get_value();
+    free_range(first + count, (1 << order) - count);
+    return first;
+}
+
+Option<size_t> BuddyAllocator::allocate_block(size_t order, size_t needed, size_t limit) {
+    ASSERT(order <= max_order);
+
+    // Every order's bitmap gives its lowest free block, so checking
+    // those is enough to find a block under the limit if there is one.
+    for (size_t current = order; current <= max_order; current++) {
+        auto maybe_block = free_blocks[current].find_first_set();
+        if (!maybe_block.has_value()) {
+            continue;
+        }
+
+        size_t block = maybe_block.get_value();
+        if ((block << current) + needed > limit) {
+            continue;
+        }
+
+        free_blocks[current].clear(block);
+
+        // Split the block, leaving the upper halves free.
+        while (current > order) {
+            current--;
+            block *= 2;
+            free_blocks[current].set(block + 1);
+        }
+
+        free_count -= 1 << order;
+        return block << order;
+    }
+
+    return {};
+}
+
+void BuddyAllocator::free(size_t unit, size_t order) {
+    ASSERT(order <= max_order);
+    ASSERT(unit % (1 << order) == 0);
+    ASSERT(unit + (1 << order) <= unit_count);
+
+    free_count += 1 << order;
+
+    size_t block = unit >> order;
+    while (order < max_order) {
+        size_t buddy = block ^ 1;
+        const Bitmap& level = free_blocks[order];
+        if (buddy >= level.get_size() || !level.get(buddy)) {
+            break;
+        }
+
+        // Merge with the buddy.
+        free_blocks[order].clear(buddy);
+        block /= 2;
+        order++;
+    }
+
+    ASSERT(!free_blocks[order].get(block));
+    free_blocks[order].set(block);
+}
+
+void BuddyAllocator::free_range(size_t first, size_t count) {
+    while (count > 0) {
+        size_t order = max_order;
+        while (first % (1 << order) != 0 || (1u << order) > count) {
+            order--;
+        }
+
+        free(first, order);
+        first += 1 << order;
+        count -= 1 << order;
+    }
+}
+
+bool BuddyAllocator::is_free(size_t unit) const {
+    ASSERT(unit < unit_count);
+
+    for (size_t order = 0; order <= max_order; order++) {
+        size_t block = unit >> order;
+        if (block < free_blocks[order].get_size() && free_blocks[order].get(block)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t BuddyAllocator::get_largest_free_block() const {
+    for (size_t order = max_order + 1; order > 0; order--) {
+        if (free_blocks[order - 1].find_first_set().has_value()) {
+            return 1 << (order - 1);
+        }
+    }
+    return 0;
+}
@@ -1,16 +1,26 @@
 #include <memory/frame_allocator.hpp>
 
+#include <arch/i386/asm.hpp>
+#include <arch/i386/cpu.hpp>
 #include <kernel/kpanic.hpp>
 #include <kernel/log.hpp>
+#include <kernel/spinlock.hpp>
+#include <memory/buddy_allocator.hpp>
 #include <memory/kernel_location.hpp>
+#include <util/array.hpp>
 #include <util/bits.hpp>
 #include <util/span.hpp>
 #include <util/math.hpp>
+#include <util/memory.hpp>
 
 namespace frame_allocator {
     struct MemoryRegion {
         paging::PhysAddr start;
-        size_t length;
+        uint64_t length;
+
+        constexpr paging::PhysAddr get_end() const {
+            return start + length;
+        }
 
         /**
          * Replace this with the intersection between this and bounds.
@@ -24,79 +34,549 @@ namespace frame_allocator {
                 ? new_end - start
                 : 0;
         }
+
+        /**
+         * Shrink the region to whole frames.
+         */
+        void align_to_frames() {
+            paging::PhysAddr end = get_end() & ~paging::PhysAddr(paging::PAGE_SIZE - 1);
+            start = (start + paging::PAGE_SIZE - 1) & ~paging::PhysAddr(paging::PAGE_SIZE - 1);
+            length = end > start
+                ? end - start
+                : 0;
+        }
     };
 
-    // We are not in Long Mode.
-    constexpr paging::PhysAddr MAX_ADDRESS = 0xffff'ffff;
+    /**
+     * Last address we manage, depends on whether paging can use PAE.
+     */
+    static paging::PhysAddr max_address = 0;
 
-    static paging::PhysAddr first_frame;
-    static size_t frame_capacity;
-    static size_t frame_count;
+    /**
+     * End of the highest available frame.
+     */
+    static paging::PhysAddr memory_end = 0;
 
-    void init(const multiboot_info_t& info) {
+    static_assert(MAX_ORDER <= BuddyAllocator::MAX_ORDER);
+
+    static constexpr paging::PhysAddr get_frame_address(size_t frame) {
+        return static_cast<paging::PhysAddr>(frame) * paging::PAGE_SIZE;
+    }
+
+    struct ZoneState {
+        size_t first_frame;
+        size_t end_frame;
+        BuddyAllocator frames;
+        size_t total_frame_count;
+
+        constexpr bool contains(size_t frame) const {
+            return frame >= first_frame && frame < end_frame;
+        }
+
+        constexpr paging::PhysAddr get_start_address() const {
+            return get_frame_address(first_frame);
+        }
+    };
+
+    static Array<ZoneState, ZONE_COUNT> zones = {{
+        { 0, (ISA_DMA_MAX_ADDRESS + 1) / paging::PAGE_SIZE, {}, 0 },
+        {
+            (ISA_DMA_MAX_ADDRESS + 1) / paging::PAGE_SIZE,
+            (DMA32_MAX_ADDRESS + 1) / paging::PAGE_SIZE,
+            {}, 0,
+        },
+        { (DMA32_MAX_ADDRESS + 1) / paging::PAGE_SIZE, 0, {}, 0 },
+    }};
+
+    static ZoneState& get_zone(Zone zone) {
+        return zones[static_cast<size_t>(zone)];
+    }
+
+    static ZoneState& get_zone_of(size_t frame) {
+        for (auto& zone : zones) {
+            if (zone.contains(frame)) return zone;
+        }
+        kpanic("Frame {:p} is not managed by the frame allocator",
+            get_frame_address(frame));
+    }
+
+    static Span<const multiboot_memory_map_t> get_memory_map(const multiboot_info_t& info) {
         bool mmap_valid = get_bit(info.flags, 6);
         if (!mmap_valid) {
             kpanic("Invalid memory map");
         }
 
-        paging::PhysAddr kernel_end_addr =
-            reinterpret_cast<paging::PhysAddr>(&kernel_end);
-        MemoryRegion available { kernel_end_addr, MAX_ADDRESS - kernel_end_addr };
-
-        Span<const multiboot_memory_map_t> mmap{
-            .start = reinterpret_cast<const multiboot_memory_map_t*>(info.mmap_addr),
+        return {
+            .start = paging::to_virtual<const multiboot_memory_map_t>(info.mmap_addr),
             .size = info.mmap_length / sizeof(multiboot_memory_map_t),
         };
+    }
 
-        for (const auto& region : mmap) {
-            if (region.type != MULTIBOOT_MEMORY_AVAILABLE) {
-                continue;
+    /**
+     * Return the part of the memory map entry we can use.
+     * The length is zero if there is none.
+     */
+    static MemoryRegion get_usable_region(const multiboot_memory_map_t& region) {
+        if (region.type != MULTIBOOT_MEMORY_AVAILABLE) {
+            return { 0, 0 };
+        }
+
+        // Everything below the kernel's end is either the kernel itself
+        // or used by the BIOS and the bootloader.
+        paging::PhysAddr kernel_end_addr = paging::to_physical(&kernel_end);
+        MemoryRegion available { kernel_end_addr, max_address + 1 - kernel_end_addr };
+
+        MemoryRegion current { region.addr, region.len };
+        current.clamp(available);
+        current.align_to_frames();
+        return current;
+    }
+
+    /**
+     * Find space for the allocator's bookkeeping. It is used before
+     * `paging::init` maps the whole physmap, so it must be in the part
+     * `boot.s` maps.
+     */
+    static Span<uint32_t> place_bookkeeping(
+        Span<const multiboot_memory_map_t> mmap, size_t word_count)
+    {
+        size_t byte_count = word_count * sizeof(uint32_t);
+        for (const auto& entry : mmap) {
+            MemoryRegion region = get_usable_region(entry);
+            if (region.length >= byte_count &&
+                region.start + byte_count <= paging::BOOT_MAP_END)
+            {
+                return {
+                    paging::to_virtual<uint32_t>(region.start),
+                    word_count,
+                };
             }
+        }
 
-            if (region.addr > MAX_ADDRESS) {
-                LOG_WARN("Available memory above 4GiB detected. It will not be used.");
-                continue;
+        kpanic("No space for the frame allocator's bookkeeping ({} bytes)", byte_count);
+    }
+
+    void init(const multiboot_info_t& info) {
+        auto mmap = get_memory_map(info);
+        max_address = min(paging::get_max_address(), MAX_MANAGED_ADDRESS);
+
+        for (const auto& entry : mmap) {
+            MemoryRegion region = get_usable_region(entry);
+            if (region.length > 0) {
+                memory_end = max(memory_end, region.get_end());
+            }
+        }
+
+        if (memory_end == 0) {
+            kpanic("No available memory");
+        }
+
+        // The last zone takes the rest of the memory.
+        zones[ZONE_COUNT - 1].end_frame = memory_end / paging::PAGE_SIZE;
+
+        size_t word_count = 0;
+        for (auto& zone : zones) {
+            zone.end_frame = min(zone.end_frame, memory_end / paging::PAGE_SIZE);
+            zone.end_frame = max(zone.end_frame, zone.first_frame);
+            word_count += BuddyAllocator::get_storage_size(
+                zone.end_frame - zone.first_frame, MAX_ORDER);
+        }
+
+        auto storage = place_bookkeeping(mmap, word_count);
+        size_t words_used = 0;
+        for (auto& zone : zones) {
+            size_t zone_size = zone.end_frame - zone.first_frame;
+            size_t zone_words = BuddyAllocator::get_storage_size(zone_size, MAX_ORDER);
+            zone.frames = BuddyAllocator(
+                { storage.start + words_used, zone_words }, zone_size, MAX_ORDER);
+            words_used += zone_words;
+        }
+
+        MemoryRegion bookkeeping {
+            paging::to_physical(storage.start),
+            storage.get_size() * sizeof(uint32_t),
+        };
+        bookkeeping.length = (bookkeeping.length + paging::PAGE_SIZE - 1)
+            & ~paging::PhysAddr(paging::PAGE_SIZE - 1);
+
+        for (const auto& entry : mmap) {
+            if (entry.type == MULTIBOOT_MEMORY_AVAILABLE &&
+                entry.addr + entry.len > max_address + 1)
+            {
+                LOG_WARN("Available memory above {:p} detected. It will not be used.",
+                    max_address);
             }
-            size_t region_start = static_cast<size_t>(region.addr);
 
-            uint64_t region_end = region.addr + region.len;
-            size_t region_len = region.len;
-            if (region_end > MAX_ADDRESS) {
-                LOG_WARN("Available memory above 4GiB detected. It will not be used.");
-                region_len = MAX_ADDRESS - region.addr;
+            MemoryRegion region = get_usable_region(entry);
+            if (region.start == bookkeeping.start) {
+                region.start += bookkeeping.length;
+                region.length -= min(region.length, bookkeeping.length);
             }
 
-            MemoryRegion current { region_start, region_len };
+            // The region may span several zones.
+            for (auto& zone : zones) {
+                MemoryRegion part = region;
+                part.clamp({
+                    zone.get_start_address(),
+                    get_frame_address(zone.end_frame - zone.first_frame),
+                });
+                if (part.length == 0) {
+                    continue;
+                }
 
-            current.clamp(available);
-            if (current.length == 0) {
-                continue;
+                size_t count = part.length / paging::PAGE_SIZE;
+                size_t first = part.start / paging::PAGE_SIZE;
+                zone.frames.free_range(first - zone.first_frame, count);
+                zone.total_frame_count += count;
             }
+        }
+    }
 
-            first_frame = current.start;
-            frame_capacity = current.length / paging::PAGE_SIZE;
-            frame_count = 0;
-            return;
+    paging::PhysAddr get_memory_end() {
+        return memory_end;
+    }
+
+    uint64_t get_total_memory() {
+        size_t total = 0;
+        for (const auto& zone : zones) {
+            total += zone.total_frame_count;
         }
+        return get_frame_address(total);
+    }
 
-        kpanic("No available memory");
+    uint64_t get_total_memory(Zone zone) {
+        return get_frame_address(get_zone(zone).total_frame_count);
     }
 
-    size_t get_total_memory() {
-        return frame_capacity * paging::PAGE_SIZE;
+    /**
+     * Per-CPU stack of free frames in front of the zones. Frames go in
+     * and out of it in batches, so most single-frame allocations
+     * and frees do not touch the zones or their lock.
+     */
+    struct Magazine {
+        Array<paging::PhysAddr, MAGAZINE_CAPACITY> frames;
+        size_t count;
+    };
+
+    static_assert(MAGAZINE_BATCH <= MAGAZINE_CAPACITY);
+
+    static Array<Magazine, cpu::MAX_CPUS> magazines;
+    static CacheStats cache_stats;
+
+    /**
+     * Protects the zones and the counters below.
+     */
+    static Spinlock zones_lock;
+
+    /**
+     * Frames currently taken from the zones and the most there has been.
+     */
+    static size_t used_frames = 0;
+    static size_t peak_used_frames = 0;
+
+    /**
+     * Call with `zones_lock` held after taking frames from the zones.
+     */
+    static void count_used_frames(size_t count) {
+        used_frames += count;
+        peak_used_frames = max(peak_used_frames, used_frames);
     }
 
-    size_t get_available_memory() {
-        return (frame_capacity - frame_count) * paging::PAGE_SIZE;
+    /**
+     * Frames zeroed ahead of time. Only touched with interrupts
+     * disabled, the zeroing itself is done with them enabled.
+     */
+    static Array<paging::PhysAddr, ZEROED_POOL_WATERMARK> zeroed_pool;
+    static size_t zeroed_pool_count = 0;
+
+    /**
+     * Call with interrupts disabled.
+     */
+    static Option<paging::PhysAddr> pop_zeroed_frame() {
+        if (zeroed_pool_count == 0) {
+            return {};
+        }
+
+        zeroed_pool_count--;
+        return zeroed_pool[zeroed_pool_count];
     }
 
-    Option<paging::PhysAddr> allocate_frame() {
-        if (frame_count >= frame_capacity) {
+    static Option<paging::PhysAddr> allocate_from_zones(size_t order) {
+        // Frames handed out here are only accessed through mappings,
+        // so high memory goes first.
+        constexpr Array<Zone, 2> ZONE_ORDER = {{ Zone::HIGH, Zone::NORMAL }};
+        for (Zone zone_id : ZONE_ORDER) {
+            auto& zone = get_zone(zone_id);
+            if (auto frame = zone.frames.allocate(order); frame.has_value()) {
+                count_used_frames(1 << order);
+                return get_frame_address(zone.first_frame + frame.get_value());
+            }
+        }
+
+        // Fall back to the DMA zone, but keep the reserve for drivers.
+        auto& dma = get_zone(Zone::DMA);
+        if (dma.frames.get_free_count() < DMA_RESERVE_FRAMES + (1u << order)) {
             return {};
         }
 
-        paging::PhysAddr frame = first_frame + frame_count * paging::PAGE_SIZE;
-        frame_count++;
+        if (auto frame = dma.frames.allocate(order); frame.has_value()) {
+            count_used_frames(1 << order);
+            return get_frame_address(dma.first_frame + frame.get_value());
+        }
+
+        return {};
+    }
+
+    static void free_to_zones(paging::PhysAddr first_frame, size_t order) {
+        ASSERT(first_frame % paging::PAGE_SIZE == 0);
+
+        size_t frame = first_frame / paging::PAGE_SIZE;
+        auto& zone = get_zone_of(frame);
+        zone.frames.free(frame - zone.first_frame, order);
+        used_frames -= 1 << order;
+    }
+
+    /**
+     * Move up to `count` frames from the zones to the magazine.
+     */
+    static void refill(Magazine& magazine, size_t count) {
+        SpinlockGuard guard(zones_lock);
+        for (size_t i = 0; i < count && magazine.count < MAGAZINE_CAPACITY; i++) {
+            auto frame = allocate_from_zones(0);
+            if (!frame.has_value()) {
+                break;
+            }
+
+            magazine.frames[magazine.count] = frame.get_value();
+            magazine.count++;
+        }
+    }
+
+    /**
+     * Move up to `count` frames from the magazine back to the zones.
+     */
+    static void drain(Magazine& magazine, size_t count) {
+        SpinlockGuard guard(zones_lock);
+        for (size_t i = 0; i < count && magazine.count > 0; i++) {
+            magazine.count--;
+            free_to_zones(magazine.frames[magazine.count], 0);
+        }
+    }
+
+    uint64_t get_available_memory() {
+        size_t available = 0;
+        {
+            SpinlockGuard guard(zones_lock);
+            for (const auto& zone : zones) {
+                available += zone.frames.get_free_count();
+            }
+        }
+
+        // Frames sitting in the magazines are free too.
+        for (const auto& magazine : magazines) {
+            available += magazine.count;
+        }
+        return get_frame_address(available);
+    }
+
+    uint64_t get_available_memory(Zone zone) {
+        SpinlockGuard guard(zones_lock);
+        return get_frame_address(get_zone(zone).frames.get_free_count());
+    }
+
+    Option<paging::PhysAddr> allocate_frame() {
+        uint32_t flags = save_and_disable_interrupts();
+        auto& magazine = magazines[cpu::get_current_index()];
+
+        if (magazine.count > 0) {
+            cache_stats.hits++;
+        } else {
+            cache_stats.misses++;
+            refill(magazine, MAGAZINE_BATCH);
+        }
+
+        Option<paging::PhysAddr> frame;
+        if (magazine.count > 0) {
+            magazine.count--;
+            frame = magazine.frames[magazine.count];
+        } else {
+            // The zeroed pool is the last resort.
+            frame = pop_zeroed_frame();
+        }
+
+        restore_interrupts(flags);
+        return frame;
+    }
+
+    Option<paging::PhysAddr> allocate_frames(size_t order) {
+        ASSERT(order <= MAX_ORDER);
+
+        SpinlockGuard guard(zones_lock);
+        return allocate_from_zones(order);
+    }
+
+    Option<paging::PhysAddr> allocate_contiguous(
+        size_t frame_count, paging::PhysAddr max_address, size_t alignment)
+    {
+        ASSERT(frame_count > 0);
+        ASSERT(alignment % paging::PAGE_SIZE == 0);
+        ASSERT((alignment & (alignment - 1)) == 0);
+
+        size_t alignment_order = ceil_log2(alignment / paging::PAGE_SIZE);
+
+        // The frame after the last one that is entirely below `max_address`.
+        paging::PhysAddr last_address = min(max_address, frame_allocator::max_address);
+        size_t limit_frame = last_address / paging::PAGE_SIZE;
+        if (last_address % paging::PAGE_SIZE == paging::PAGE_SIZE - 1) {
+            limit_frame++;
+        }
+
+        SpinlockGuard guard(zones_lock);
+
+        // Try the higher zones first to spare the DMA zone.
+        for (size_t i = ZONE_COUNT; i > 0; i--) {
+            auto& zone = zones[i - 1];
+            if (zone.first_frame >= limit_frame) {
+                continue;
+            }
+
+            auto maybe_first = zone.frames.allocate_range(
+                frame_count, alignment_order, limit_frame - zone.first_frame);
+            if (maybe_first.has_value()) {
+                count_used_frames(frame_count);
+                return get_frame_address(zone.first_frame + maybe_first.get_value());
+            }
+        }
+
+        return {};
+    }
+
+    void free_frame(paging::PhysAddr frame) {
+        ASSERT(frame % paging::PAGE_SIZE == 0);
+
+        uint32_t flags = save_and_disable_interrupts();
+        auto& magazine = magazines[cpu::get_current_index()];
+
+        if (magazine.count == MAGAZINE_CAPACITY) {
+            cache_stats.drains++;
+            drain(magazine, MAGAZINE_BATCH);
+        }
+
+        magazine.frames[magazine.count] = frame;
+        magazine.count++;
+
+        restore_interrupts(flags);
+    }
+
+    void free_frames(paging::PhysAddr first_frame, size_t order) {
+        SpinlockGuard guard(zones_lock);
+        free_to_zones(first_frame, order);
+    }
+
+    void free_contiguous(paging::PhysAddr first_frame, size_t frame_count) {
+        ASSERT(first_frame % paging::PAGE_SIZE == 0);
+
+        SpinlockGuard guard(zones_lock);
+        size_t frame = first_frame / paging::PAGE_SIZE;
+        auto& zone = get_zone_of(frame);
+        ASSERT(frame + frame_count <= zone.end_frame);
+        zone.frames.free_range(frame - zone.first_frame, frame_count);
+        used_frames -= frame_count;
+    }
+
+    /**
+     * Zero a frame through the physmap, or a temporary mapping
+     * if it is above it.
+     */
+    static bool zero_frame(paging::PhysAddr frame) {
+        if (frame < paging::PHYSMAP_SIZE) {
+            memset(paging::to_virtual(frame), 0, paging::PAGE_SIZE);
+            return true;
+        }
+
+        void* page = paging::map_temporary(frame);
+        if (!page) {
+            return false;
+        }
+        memset(page, 0, paging::PAGE_SIZE);
+        paging::unmap_temporary(page);
+        return true;
+    }
+
+    Option<paging::PhysAddr> take_zeroed_frame() {
+        uint32_t flags = save_and_disable_interrupts();
+        auto frame = pop_zeroed_frame();
+        if (frame.has_value()) {
+            cache_stats.zeroed_hits++;
+        } else {
+            cache_stats.zeroed_misses++;
+        }
+        restore_interrupts(flags);
         return frame;
     }
+
+    bool fill_zeroed_pool() {
+        for (size_t i = 0; i < ZEROED_FILL_BATCH; i++) {
+            if (zeroed_pool_count >= ZEROED_POOL_WATERMARK) {
+                return false;
+            }
+
+            // Do not take the last frames, they are better used
+            // for whatever needs them right away.
+            if (get_available_memory() <= get_frame_address(ZEROED_POOL_WATERMARK)) {
+                return false;
+            }
+
+            auto frame = allocate_frame();
+            if (!frame.has_value()) {
+                return false;
+            }
+
+            if (!zero_frame(frame.get_value())) {
+                free_frame(frame.get_value());
+                return false;
+            }
+
+            uint32_t flags = save_and_disable_interrupts();
+            bool added = zeroed_pool_count < ZEROED_POOL_WATERMARK;
+            if (added) {
+                zeroed_pool[zeroed_pool_count] = frame.get_value();
+                zeroed_pool_count++;
+            }
+            restore_interrupts(flags);
+
+            if (!added) {
+                free_frame(frame.get_value());
+            }
+        }
+
+        return zeroed_pool_count < ZEROED_POOL_WATERMARK;
+    }
+
+    void drain_caches() {
+        uint32_t flags = save_and_disable_interrupts();
+        for (auto& magazine : magazines) {
+            drain(magazine, magazine.count);
+        }
+        restore_interrupts(flags);
+    }
+
+    CacheStats get_cache_stats() {
+        return cache_stats;
+    }
+
+    ZoneStats get_zone_stats(Zone zone_id) {
+        SpinlockGuard guard(zones_lock);
+        const auto& zone = get_zone(zone_id);
+        return {
+            .total_frames = zone.total_frame_count,
+            .free_frames = zone.frames.get_free_count(),
+            .largest_free_block = zone.frames.get_largest_free_block(),
+        };
+    }
+
+    uint64_t get_peak_used_memory() {
+        SpinlockGuard guard(zones_lock);
+        return get_frame_address(peak_used_frames);
+    }
 }
@@ -4,7 +4,7 @@
  */
 
 #include <kernel/kpanic.hpp>
-#include <memory/liballoc.h>
+#include <memory/kmalloc.hpp>
 
 void* operator new(size_t size) {
     if (auto ptr = kmalloc(size)) {
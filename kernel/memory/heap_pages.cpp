@@ -0,0 +1,405 @@
+/**
+ * @file
+ * Heap page management, also used to implement the liballoc hooks.
+ */
+
+#include <memory/heap_pages.hpp>
+
+#include <arch/i386/paging.hpp>
+#include <arch/i386/tlb.hpp>
+#include <kernel/log.hpp>
+#include <kernel/spinlock.hpp>
+#include <memory/frame_allocator.hpp>
+#include <memory/kmalloc.hpp>
+#include <memory/liballoc.h>
+#include <memory/object_cache.hpp>
+#include <memory/virtual_range_allocator.hpp>
+#include <util/array.hpp>
+#include <util/math.hpp>
+#include <util/memory.hpp>
+
+/**
+ * Protects liballoc's own data structures.
+ */
+static Spinlock liballoc_spinlock;
+
+/** This function is supposed to lock the memory data structures. It
+ * could be as simple as disabling interrupts or acquiring a spinlock.
+ * It's up to you to decide. 
+ *
+ * \return 0 if the lock was acquired successfully. Anything else is
+ * failure.
+ */
+extern "C" int liballoc_lock() {
+    liballoc_spinlock.lock();
+    return 0;
+}
+
+/** This function unlocks what was previously locked by the liballoc_lock
+ * function.  If it disabled interrupts, it enables interrupts. If it
+ * had acquiried a spinlock, it releases the spinlock. etc.
+ *
+ * \return 0 if the lock was successfully released.
+ */
+extern "C" int liballoc_unlock() {
+    liballoc_spinlock.unlock();
+    return 0;
+}
+
+namespace heap {
+    /**
+     * The heap reserves everything between the physmap and the
+     * temporary mappings (496MiB), pages are only mapped as it grows.
+     */
+    constexpr paging::VirtAddr HEAP_START = paging::PHYSMAP_END;
+    constexpr paging::VirtAddr HEAP_END = paging::TEMPORARY_MAP_START;
+    constexpr size_t HEAP_PAGES = (HEAP_END - HEAP_START) / paging::PAGE_SIZE;
+
+    /** One range can cover the whole window. */
+    constexpr size_t MAX_RANGE_ORDER = ceil_log2(HEAP_PAGES);
+    static_assert(MAX_RANGE_ORDER <= BuddyAllocator::MAX_ORDER);
+
+    static Array<uint32_t, VirtualRangeAllocator::get_storage_size(HEAP_PAGES, MAX_RANGE_ORDER)>
+        range_storage;
+    static VirtualRangeAllocator ranges;
+
+    constexpr size_t LARGE_PAGE_ORDER = 10;
+    constexpr size_t PAGES_PER_LARGE_PAGE = 1 << LARGE_PAGE_ORDER;
+    static_assert(PAGES_PER_LARGE_PAGE * paging::PAGE_SIZE == paging::LARGE_PAGE_SIZE);
+    static_assert(LARGE_PAGE_ORDER <= frame_allocator::MAX_ORDER);
+
+    static size_t mapped_pages = 0;
+    static size_t peak_mapped_pages = 0;
+    static size_t limit_pages = HEAP_PAGES;
+
+    void init() {
+        ranges = VirtualRangeAllocator(
+            { range_storage.begin(), range_storage.get_size() },
+            HEAP_START, HEAP_END, MAX_RANGE_ORDER);
+
+        // Leave some memory for page tables and drivers by default.
+        uint64_t default_limit = frame_allocator::get_total_memory() / 4 * 3;
+        set_limit(min(default_limit, HEAP_END - HEAP_START));
+    }
+
+    void set_limit(size_t bytes) {
+        limit_pages = min(bytes / paging::PAGE_SIZE, HEAP_PAGES);
+    }
+
+    size_t get_limit() {
+        return limit_pages * paging::PAGE_SIZE;
+    }
+
+    size_t get_mapped_memory() {
+        return mapped_pages * paging::PAGE_SIZE;
+    }
+
+    size_t get_peak_mapped_memory() {
+        return peak_mapped_pages * paging::PAGE_SIZE;
+    }
+
+    /**
+     * Protects `ranges`, the page counters and the heap's mappings.
+     * Taken after the slab allocators' locks. `trim` is only called
+     * without it, it frees pages.
+     */
+    static Spinlock pages_lock;
+
+    size_t get_reserved_memory() {
+        SpinlockGuard guard(pages_lock);
+        return (HEAP_PAGES - ranges.get_free_pages()) * paging::PAGE_SIZE;
+    }
+
+    size_t get_free_address_space() {
+        SpinlockGuard guard(pages_lock);
+        return ranges.get_free_pages() * paging::PAGE_SIZE;
+    }
+
+    size_t get_largest_free_range() {
+        SpinlockGuard guard(pages_lock);
+        return ranges.get_largest_free_range() * paging::PAGE_SIZE;
+    }
+
+    size_t trim() {
+        return kmalloc_trim() + ObjectCacheBase::reclaim_all();
+    }
+
+    /**
+     * Allocate a frame for a page that has to start out zeroed.
+     * `zeroed` is set if it already is, otherwise the caller
+     * zeroes it once it is mapped.
+     */
+    static Option<paging::PhysAddr> allocate_frame_to_zero(bool& zeroed) {
+        auto frame = frame_allocator::take_zeroed_frame();
+        zeroed = frame.has_value();
+        if (zeroed) {
+            return frame;
+        }
+        return frame_allocator::allocate_frame();
+    }
+
+    static void zero_pages(paging::VirtAddr start, size_t size) {
+        memset(reinterpret_cast<void*>(start), 0, size);
+    }
+
+    /** A frame unmapped in the current TLB batch, not freed yet. */
+    struct UnmappedFrame {
+        paging::PhysAddr frame;
+        size_t order;
+    };
+
+    /**
+     * End the TLB batch and only then free the frames, stale entries
+     * may point at them until the flush.
+     */
+    static void free_unmapped_frames(Span<const UnmappedFrame> frames) {
+        tlb::end_batch();
+        for (const UnmappedFrame& unmapped : frames) {
+            if (unmapped.order == 0) {
+                frame_allocator::free_frame(unmapped.frame);
+            } else {
+                frame_allocator::free_frames(unmapped.frame, unmapped.order);
+            }
+        }
+    }
+
+    static void unmap_pages(paging::VirtAddr start_addr, size_t count) {
+        // Flush once per batch of frames, the frames and the range
+        // are released after that.
+        Array<UnmappedFrame, 32> unmapped;
+        size_t unmapped_count = 0;
+
+        tlb::begin_batch();
+        for (size_t i = 0; i < count; i++) {
+            paging::VirtAddr page = start_addr + i * paging::PAGE_SIZE;
+            auto frame = paging::translate(page);
+            if (!frame.has_value()) {
+                continue;
+            }
+
+            if (unmapped_count == unmapped.get_size()) {
+                free_unmapped_frames({ unmapped.begin(), unmapped_count });
+                unmapped_count = 0;
+                tlb::begin_batch();
+            }
+
+            if (paging::is_large_page(page)) {
+                paging::unmap_large(page);
+                unmapped[unmapped_count++] = { frame.get_value(), LARGE_PAGE_ORDER };
+                mapped_pages -= PAGES_PER_LARGE_PAGE;
+                i += PAGES_PER_LARGE_PAGE - 1;
+                continue;
+            }
+
+            paging::unmap(page);
+            unmapped[unmapped_count++] = { frame.get_value(), 0 };
+            mapped_pages--;
+        }
+        free_unmapped_frames({ unmapped.begin(), unmapped_count });
+
+        ranges.free(start_addr, count);
+    }
+
+    /**
+     * Call with `pages_lock` held. Return nullptr if the pages would
+     * go over the limit or there are not enough frames.
+     */
+    static void* try_allocate_pages(size_t count, bool zeroed) {
+        auto region_size = count * paging::PAGE_SIZE;
+
+        if (mapped_pages + count > limit_pages) {
+            return nullptr;
+        }
+
+        // Big regions are aligned so that they can use large pages.
+        bool use_large_pages = paging::supports_large_pages() && count >= PAGES_PER_LARGE_PAGE;
+        auto maybe_region = ranges.allocate(
+            count, use_large_pages ? paging::LARGE_PAGE_SIZE : paging::PAGE_SIZE);
+        if (!maybe_region.has_value()) [[unlikely]] {
+            return nullptr;
+        }
+        auto region = maybe_region.get_value();
+
+        for (size_t offset = 0; offset < region_size; offset += paging::PAGE_SIZE) {
+            bool large_page_fits = offset % paging::LARGE_PAGE_SIZE == 0
+                && region_size - offset >= paging::LARGE_PAGE_SIZE;
+            if (use_large_pages && large_page_fits) {
+                // Fall back to 4KiB frames if there is no free 4MiB block.
+                auto frames = frame_allocator::allocate_frames(LARGE_PAGE_ORDER);
+                if (frames.has_value()) {
+                    paging::map(
+                        region + offset,
+                        frames.get_value(),
+                        paging::PageFlags{ .writable = true, .large = true });
+                    if (zeroed) {
+                        zero_pages(region + offset, paging::LARGE_PAGE_SIZE);
+                    }
+                    mapped_pages += PAGES_PER_LARGE_PAGE;
+                    offset += paging::LARGE_PAGE_SIZE - paging::PAGE_SIZE;
+                    continue;
+                }
+            }
+
+            bool frame_zeroed = false;
+            auto maybe_frame = zeroed
+                ? allocate_frame_to_zero(frame_zeroed)
+                : frame_allocator::allocate_frame();
+            if (!maybe_frame.has_value()) [[unlikely]] {
+                // Unmapped pages are skipped, this also releases the whole range.
+                unmap_pages(region, count);
+                return nullptr;
+            }
+
+            paging::map(
+                region + offset,
+                maybe_frame.get_value(),
+                paging::PageFlags{ .writable = true });
+            if (zeroed && !frame_zeroed) {
+                zero_pages(region + offset, paging::PAGE_SIZE);
+            }
+            mapped_pages++;
+        }
+
+        peak_mapped_pages = max(peak_mapped_pages, mapped_pages);
+
+        return reinterpret_cast<void*>(region);
+    }
+
+    static void* allocate_pages(size_t count, bool zeroed) {
+        for (bool trimmed = false; ; trimmed = true) {
+            {
+                SpinlockGuard guard(pages_lock);
+                if (void* pages = try_allocate_pages(count, zeroed)) {
+                    return pages;
+                }
+            }
+
+            // Low on memory, take back the idle pages and try again.
+            if (trimmed || trim() == 0) {
+                break;
+            }
+        }
+
+        LOG_ERROR("Failed to allocate {} pages for the heap ({} mapped, limit {}).",
+            count, mapped_pages, limit_pages);
+        return nullptr;
+    }
+
+    void* allocate_pages(size_t count) {
+        return allocate_pages(count, false);
+    }
+
+    void* allocate_zeroed_pages(size_t count) {
+        return allocate_pages(count, true);
+    }
+
+    void* reserve_pages(size_t count) {
+        Option<paging::VirtAddr> region;
+        {
+            SpinlockGuard guard(pages_lock);
+            region = ranges.allocate(count);
+        }
+
+        if (!region.has_value()) [[unlikely]] {
+            LOG_ERROR("Failed to reserve {} pages for the heap.", count);
+            return nullptr;
+        }
+
+        return reinterpret_cast<void*>(region.get_value());
+    }
+
+    enum class CommitResult {
+        COMMITTED,
+        NOT_OURS,
+        NO_MEMORY,
+    };
+
+    /**
+     * Call with `pages_lock` held.
+     */
+    static CommitResult try_commit_page(paging::VirtAddr address) {
+        if (!ranges.is_allocated(address)) {
+            return CommitResult::NOT_OURS;
+        }
+
+        paging::VirtAddr page = address & ~(paging::PAGE_SIZE - 1);
+        if (paging::is_mapped(page)) {
+            // A protection fault, not a missing page.
+            return CommitResult::NOT_OURS;
+        }
+
+        if (mapped_pages + 1 > limit_pages) {
+            return CommitResult::NO_MEMORY;
+        }
+
+        bool zeroed = false;
+        auto frame = allocate_frame_to_zero(zeroed);
+        if (!frame.has_value()) {
+            return CommitResult::NO_MEMORY;
+        }
+
+        if (!paging::map(page, frame.get_value(), paging::PageFlags{ .writable = true })) {
+            frame_allocator::free_frame(frame.get_value());
+            return CommitResult::NO_MEMORY;
+        }
+
+        if (!zeroed) {
+            zero_pages(page, paging::PAGE_SIZE);
+        }
+
+        mapped_pages++;
+        peak_mapped_pages = max(peak_mapped_pages, mapped_pages);
+        return CommitResult::COMMITTED;
+    }
+
+    bool handle_page_fault(paging::VirtAddr address) {
+        for (bool trimmed = false; ; trimmed = true) {
+            CommitResult result;
+            {
+                SpinlockGuard guard(pages_lock);
+                result = try_commit_page(address);
+            }
+
+            if (result != CommitResult::NO_MEMORY) {
+                return result == CommitResult::COMMITTED;
+            }
+
+            if (trimmed || trim() == 0) {
+                break;
+            }
+        }
+
+        LOG_ERROR("No memory to commit heap page {:p} ({} mapped, limit {}).",
+            address, mapped_pages, limit_pages);
+        return false;
+    }
+
+    void free_pages(void* start, size_t count) {
+        SpinlockGuard guard(pages_lock);
+        unmap_pages(reinterpret_cast<paging::VirtAddr>(start), count);
+    }
+}
+
+/** This is the hook into the local system which allocates pages. It
+ * accepts an integer parameter which is the number of pages
+ * required.  The page size was set up in the liballoc_init function.
+ *
+ * \return NULL if the pages were not allocated.
+ * \return A pointer to the allocated memory.
+ */
+extern "C" void* liballoc_alloc(size_t pages) {
+    return heap::allocate_pages(pages);
+}
+
+/** This frees previously allocated memory. The void* parameter passed
+ * to the function is the exact same value returned from a previous
+ * liballoc_alloc call.
+ *
+ * The integer value is the number of pages to free.
+ *
+ * \return 0 if the memory was successfully freed.
+ */
+extern "C" int liballoc_free(void* start, size_t pages) {
+    heap::free_pages(start, pages);
+    return 0;
+}
@@ -0,0 +1,562 @@
+#include <memory/kmalloc.hpp>
+
+#include <stdint.h>
+#include <arch/i386/asm.hpp>
+#include <arch/i386/cpu.hpp>
+#include <arch/i386/paging.hpp>
+#include <kernel/log.hpp>
+#include <kernel/spinlock.hpp>
+#include <memory/heap_pages.hpp>
+#include <util/array.hpp>
+#include <util/assert.hpp>
+#include <util/math.hpp>
+#include <util/memory.hpp>
+
+static constexpr uint32_t SLAB_MAGIC = 0x51ab'c0de;
+
+/**
+ * Size class of slabs holding a single big allocation.
+ */
+static constexpr uint16_t LARGE_CLASS = 0xffff;
+
+struct FreeObject {
+    FreeObject* next;
+};
+
+/**
+ * Header at the start of every page run the heap gets.
+ * Objects start right after it.
+ */
+struct alignas(16) Slab {
+    uint32_t magic;
+    uint16_t size_class;
+    uint16_t used; // Objects in use.
+    size_t page_count;
+    FreeObject* free_list;
+
+    // Links in the size class's list of slabs with free objects.
+    Slab* prev;
+    Slab* next;
+
+    // Big allocation whose pages are mapped on first touch.
+    bool on_demand;
+};
+
+static constexpr size_t HEADER_SIZE = sizeof(Slab);
+static_assert(HEADER_SIZE == 32);
+
+static constexpr size_t CLASS_COUNT = 21;
+
+/**
+ * Multiples of 16 growing by about a quarter, the biggest
+ * one still fits twice in a page.
+ */
+static constexpr Array<size_t, CLASS_COUNT> CLASS_SIZES = {{
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224,
+    256, 320, 384, 448, 512, 640, 768, 1008, 1344, 2032,
+}};
+
+static constexpr size_t MAX_SMALL_SIZE = CLASS_SIZES[CLASS_COUNT - 1];
+
+/**
+ * Allocations this big are only backed by frames where they get touched.
+ */
+static constexpr size_t ON_DEMAND_SIZE = 64 * 1024;
+static_assert(2 * MAX_SMALL_SIZE + HEADER_SIZE <= paging::PAGE_SIZE);
+
+/**
+ * Free objects each CPU keeps per size class, exchanged
+ * with the slabs CPU_CACHE_BATCH at a time.
+ */
+static constexpr size_t CPU_CACHE_CAPACITY = 32;
+static constexpr size_t CPU_CACHE_BATCH = 16;
+static_assert(CPU_CACHE_BATCH <= CPU_CACHE_CAPACITY);
+
+/**
+ * Size class index for every size rounded up to 16 bytes.
+ */
+static constexpr Array<uint8_t, MAX_SMALL_SIZE / 16 + 1> CLASS_OF_SIZE = []() {
+    Array<uint8_t, MAX_SMALL_SIZE / 16 + 1> result;
+    size_t size_class = 0;
+    for (size_t i = 0; i < result.get_size(); i++) {
+        while (CLASS_SIZES[size_class] < i * 16) {
+            size_class++;
+        }
+        result[i] = size_class;
+    }
+    return result;
+}();
+
+struct SizeClass {
+    Slab* partial; // Slabs with free objects.
+    Slab* empty; // One empty slab is kept so that alloc/free cycles don't remap pages.
+    size_t slab_count;
+};
+
+static Array<SizeClass, CLASS_COUNT> size_classes;
+
+/**
+ * Protects the slabs and `size_classes`. Taken after `cpu_caches`
+ * runs out or fills up, and before the heap's page lock.
+ */
+static Spinlock slabs_lock;
+
+/**
+ * Free objects of one size class kept by a CPU, linked through
+ * their first word.
+ */
+struct ObjectStack {
+    FreeObject* top;
+    size_t count;
+};
+
+/**
+ * Front-end of the slabs for each CPU. Only used by its CPU with
+ * interrupts disabled, so it needs no lock.
+ */
+struct CpuCache {
+    Array<ObjectStack, CLASS_COUNT> stacks;
+    size_t hits;
+    size_t misses;
+
+    // Objects of each class handed out and freed on this CPU.
+    Array<size_t, CLASS_COUNT> allocations;
+    Array<size_t, CLASS_COUNT> frees;
+};
+
+static Array<CpuCache, cpu::MAX_CPUS> cpu_caches;
+
+static size_t lock_acquisitions = 0;
+static size_t lock_contentions = 0;
+
+/**
+ * Large allocations take no lock, these are updated atomically.
+ */
+static size_t large_allocations = 0;
+static size_t large_in_use = 0;
+static size_t large_pages = 0;
+
+static void lock_slabs() {
+    if (!slabs_lock.try_lock()) {
+        slabs_lock.lock();
+        lock_contentions++;
+    }
+    lock_acquisitions++;
+}
+
+static Slab* get_slab(void* ptr) {
+    return reinterpret_cast<Slab*>(
+        reinterpret_cast<uintptr_t>(ptr) & ~(paging::PAGE_SIZE - 1));
+}
+
+static void link(Slab*& head, Slab* slab) {
+    slab->prev = nullptr;
+    slab->next = head;
+    if (head) head->prev = slab;
+    head = slab;
+}
+
+static void unlink(Slab*& head, Slab* slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else head = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->prev = nullptr;
+    slab->next = nullptr;
+}
+
+static Slab* create_slab(uint16_t size_class) {
+    void* page = heap::allocate_pages(1);
+    if (!page) {
+        return nullptr;
+    }
+
+    Slab* slab = new (page) Slab{
+        .magic = SLAB_MAGIC,
+        .size_class = size_class,
+        .used = 0,
+        .page_count = 1,
+        .free_list = nullptr,
+        .prev = nullptr,
+        .next = nullptr,
+        .on_demand = false,
+    };
+
+    size_t object_size = CLASS_SIZES[size_class];
+    size_t object_count = (paging::PAGE_SIZE - HEADER_SIZE) / object_size;
+    auto objects = reinterpret_cast<uintptr_t>(page) + HEADER_SIZE;
+
+    // Push in reverse, so that objects are handed out in address order.
+    for (size_t i = object_count; i > 0; i--) {
+        auto object = reinterpret_cast<FreeObject*>(objects + (i - 1) * object_size);
+        object->next = slab->free_list;
+        slab->free_list = object;
+    }
+
+    return slab;
+}
+
+/**
+ * Call with `slabs_lock` held.
+ */
+static FreeObject* take_object(uint16_t size_class) {
+    auto& state = size_classes[size_class];
+
+    Slab* slab = state.partial;
+    if (!slab) {
+        if (state.empty) {
+            slab = state.empty;
+            state.empty = nullptr;
+        } else {
+            slab = create_slab(size_class);
+            if (!slab) return nullptr;
+            state.slab_count++;
+        }
+        link(state.partial, slab);
+    }
+
+    FreeObject* object = slab->free_list;
+    slab->free_list = object->next;
+    slab->used++;
+
+    if (!slab->free_list) {
+        unlink(state.partial, slab);
+    }
+
+    return object;
+}
+
+/**
+ * Call with `slabs_lock` held.
+ */
+static void return_object(FreeObject* object) {
+    Slab* slab = get_slab(object);
+    auto& state = size_classes[slab->size_class];
+
+    bool was_full = slab->free_list == nullptr;
+    object->next = slab->free_list;
+    slab->free_list = object;
+    slab->used--;
+
+    if (was_full) {
+        link(state.partial, slab);
+    }
+
+    if (slab->used == 0) {
+        unlink(state.partial, slab);
+        if (!state.empty) {
+            state.empty = slab;
+        } else {
+            heap::free_pages(slab, 1);
+            state.slab_count--;
+        }
+    }
+}
+
+/**
+ * Move up to CPU_CACHE_BATCH objects from the slabs to the stack.
+ */
+static void refill(ObjectStack& stack, uint16_t size_class) {
+    lock_slabs();
+    for (size_t i = 0; i < CPU_CACHE_BATCH; i++) {
+        FreeObject* object = take_object(size_class);
+        if (!object) {
+            break;
+        }
+
+        object->next = stack.top;
+        stack.top = object;
+        stack.count++;
+    }
+    slabs_lock.unlock();
+}
+
+/**
+ * Move up to `count` objects from the stack back to their slabs.
+ */
+static void drain(ObjectStack& stack, size_t count) {
+    lock_slabs();
+    for (size_t i = 0; i < count && stack.top; i++) {
+        FreeObject* object = stack.top;
+        stack.top = object->next;
+        stack.count--;
+        return_object(object);
+    }
+    slabs_lock.unlock();
+}
+
+static void* allocate_small(uint16_t size_class) {
+    uint32_t flags = save_and_disable_interrupts();
+    auto& cache = cpu_caches[cpu::get_current_index()];
+    auto& stack = cache.stacks[size_class];
+
+    if (stack.top) {
+        cache.hits++;
+    } else {
+        cache.misses++;
+        refill(stack, size_class);
+    }
+
+    FreeObject* object = stack.top;
+    if (object) {
+        stack.top = object->next;
+        stack.count--;
+        cache.allocations[size_class]++;
+    }
+
+    restore_interrupts(flags);
+    return object;
+}
+
+static void free_small(void* ptr) {
+    uint32_t flags = save_and_disable_interrupts();
+    auto& cache = cpu_caches[cpu::get_current_index()];
+    uint16_t size_class = get_slab(ptr)->size_class;
+    auto& stack = cache.stacks[size_class];
+    cache.frees[size_class]++;
+
+    if (stack.count == CPU_CACHE_CAPACITY) {
+        drain(stack, CPU_CACHE_BATCH);
+    }
+
+    auto object = static_cast<FreeObject*>(ptr);
+    object->next = stack.top;
+    stack.top = object;
+    stack.count++;
+
+    restore_interrupts(flags);
+}
+
+/**
+ * With `zeroed`, the memory comes zeroed, pages mapped
+ * on demand always do.
+ */
+static void* allocate_large(size_t size, bool zeroed) {
+    if (size > SIZE_MAX - HEADER_SIZE - paging::PAGE_SIZE) {
+        return nullptr;
+    }
+
+    size_t page_count = (size + HEADER_SIZE + paging::PAGE_SIZE - 1) / paging::PAGE_SIZE;
+    bool on_demand = size >= ON_DEMAND_SIZE;
+    void* start;
+    if (on_demand) {
+        start = heap::reserve_pages(page_count);
+    } else if (zeroed) {
+        start = heap::allocate_zeroed_pages(page_count);
+    } else {
+        start = heap::allocate_pages(page_count);
+    }
+    if (!start) {
+        return nullptr;
+    }
+
+    new (start) Slab{
+        .magic = SLAB_MAGIC,
+        .size_class = LARGE_CLASS,
+        .used = 1,
+        .page_count = page_count,
+        .free_list = nullptr,
+        .prev = nullptr,
+        .next = nullptr,
+        .on_demand = on_demand,
+    };
+
+    __atomic_fetch_add(&large_allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&large_in_use, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&large_pages, page_count, __ATOMIC_RELAXED);
+
+    return reinterpret_cast<uint8_t*>(start) + HEADER_SIZE;
+}
+
+/**
+ * Return the slab `ptr` was allocated from, or nullptr if it
+ * does not look like a pointer returned by kmalloc.
+ */
+static Slab* find_slab(void* ptr) {
+    Slab* slab = get_slab(ptr);
+    if (slab->magic != SLAB_MAGIC) {
+        return nullptr;
+    }
+
+    auto offset = reinterpret_cast<uintptr_t>(ptr) - reinterpret_cast<uintptr_t>(slab);
+    if (offset < HEADER_SIZE) {
+        return nullptr;
+    }
+
+    if (slab->size_class == LARGE_CLASS) {
+        return offset == HEADER_SIZE ? slab : nullptr;
+    }
+
+    if ((offset - HEADER_SIZE) % CLASS_SIZES[slab->size_class] != 0) {
+        return nullptr;
+    }
+
+    return slab;
+}
+
+static size_t get_usable_size(const Slab* slab) {
+    if (slab->size_class == LARGE_CLASS) {
+        return slab->page_count * paging::PAGE_SIZE - HEADER_SIZE;
+    }
+    return CLASS_SIZES[slab->size_class];
+}
+
+void* kmalloc(size_t size) {
+    if (size <= MAX_SMALL_SIZE) {
+        return allocate_small(CLASS_OF_SIZE[(size + 15) / 16]);
+    }
+
+    return allocate_large(size, false);
+}
+
+void* kcalloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return nullptr;
+    }
+
+    size_t total = count * size;
+    if (total > MAX_SMALL_SIZE) {
+        return allocate_large(total, true);
+    }
+
+    void* ptr = kmalloc(total);
+    if (!ptr) {
+        return nullptr;
+    }
+
+    memset(ptr, 0, get_usable_size(get_slab(ptr)));
+    return ptr;
+}
+
+void* krealloc(void* ptr, size_t size) {
+    if (!ptr) {
+        return kmalloc(size);
+    }
+
+    if (size == 0) {
+        kfree(ptr);
+        return nullptr;
+    }
+
+    Slab* slab = find_slab(ptr);
+    if (!slab) {
+        LOG_ERROR("krealloc({:p}) on memory not allocated by kmalloc.", ptr);
+        return nullptr;
+    }
+
+    size_t old_size = get_usable_size(slab);
+    if (size <= old_size) {
+        return ptr;
+    }
+
+    void* new_ptr = kmalloc(size);
+    if (!new_ptr) {
+        return nullptr;
+    }
+
+    memcpy(new_ptr, ptr, old_size);
+    kfree(ptr);
+    return new_ptr;
+}
+
+size_t kmalloc_trim() {
+    // The heap trims itself when it runs out of frames, which
+    // may happen inside kmalloc, with the lock already held.
+    if (!slabs_lock.try_lock()) {
+        return 0;
+    }
+    lock_acquisitions++;
+
+    auto& cache = cpu_caches[cpu::get_current_index()];
+    for (auto& stack : cache.stacks) {
+        while (stack.top) {
+            FreeObject* object = stack.top;
+            stack.top = object->next;
+            return_object(object);
+        }
+        stack.count = 0;
+    }
+
+    size_t freed = 0;
+    for (auto& state : size_classes) {
+        if (state.empty) {
+            state.empty->magic = 0;
+            heap::free_pages(state.empty, 1);
+            state.empty = nullptr;
+            state.slab_count--;
+            freed++;
+        }
+    }
+
+    slabs_lock.unlock();
+    return freed;
+}
+
+KmallocStats kmalloc_get_stats() {
+    KmallocStats stats{};
+    for (const auto& cache : cpu_caches) {
+        stats.cache_hits += cache.hits;
+        stats.cache_misses += cache.misses;
+    }
+    stats.lock_acquisitions = lock_acquisitions;
+    stats.lock_contentions = lock_contentions;
+
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        auto class_stats = kmalloc_get_class_stats(i);
+        stats.slab_pages += class_stats.slabs;
+        stats.bytes_in_use += class_stats.in_use * class_stats.object_size;
+    }
+
+    stats.large_allocations = __atomic_load_n(&large_allocations, __ATOMIC_RELAXED);
+    stats.large_in_use = __atomic_load_n(&large_in_use, __ATOMIC_RELAXED);
+    stats.large_pages = __atomic_load_n(&large_pages, __ATOMIC_RELAXED);
+    stats.bytes_in_use += stats.large_pages * paging::PAGE_SIZE
+        - stats.large_in_use * HEADER_SIZE;
+    return stats;
+}
+
+size_t kmalloc_get_class_count() {
+    return CLASS_COUNT;
+}
+
+KmallocClassStats kmalloc_get_class_stats(size_t size_class) {
+    ASSERT(size_class < CLASS_COUNT);
+
+    KmallocClassStats stats{};
+    stats.object_size = CLASS_SIZES[size_class];
+
+    // Objects can be freed on another CPU than the one they came from,
+    // only the totals make sense.
+    size_t frees = 0;
+    for (const auto& cache : cpu_caches) {
+        stats.allocations += cache.allocations[size_class];
+        frees += cache.frees[size_class];
+    }
+    stats.in_use = stats.allocations - frees;
+
+    // Not counted in the lock stats, reading them should not change them.
+    slabs_lock.lock();
+    stats.slabs = size_classes[size_class].slab_count;
+    slabs_lock.unlock();
+    return stats;
+}
+
+void kfree(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    Slab* slab = find_slab(ptr);
+    if (!slab) {
+        LOG_ERROR("kfree({:p}) on memory not allocated by kmalloc.", ptr);
+        return;
+    }
+
+    if (slab->size_class == LARGE_CLASS) {
+        slab->magic = 0;
+        __atomic_fetch_sub(&large_in_use, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&large_pages, slab->page_count, __ATOMIC_RELAXED);
+        heap::free_pages(slab, slab->page_count);
+    } else {
+        free_small(ptr);
+    }
+}
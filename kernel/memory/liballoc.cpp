@@ -4,6 +4,7 @@
  */
 
 #include <memory/liballoc.h>
+#include <util/memory.hpp>
 
 /**  Durand's Amazing Super Duper Memory functions.  */
 
@@ -111,35 +112,11 @@ static long long l_possibleOverruns = 0;	///< Number of possible overruns
 
 static void *liballoc_memset(void* s, int c, size_t n)
 {
-	unsigned int i;
-	for ( i = 0; i < n ; i++)
-		((char*)s)[i] = c;
-	
-	return s;
+	return memset( s, c, n );
 }
 static void* liballoc_memcpy(void* s1, const void* s2, size_t n)
 {
-  char *cdest;
-  char *csrc;
-  unsigned int *ldest = (unsigned int*)s1;
-  unsigned int *lsrc  = (unsigned int*)s2;
-
-  while ( n >= sizeof(unsigned int) )
-  {
-      *ldest++ = *lsrc++;
-	  n -= sizeof(unsigned int);
-  }
-
-  cdest = (char*)ldest;
-  csrc  = (char*)lsrc;
-  
-  while ( n > 0 )
-  {
-      *cdest++ = *csrc++;
-	  n -= 1;
-  }
-  
-  return s1;
+	return memcpy( s1, s2, n );
 }
  
 
@@ -835,3 +812,16 @@ void*   PREFIX(realloc)(void *p, size_t size)
 
 
 
+
+
+
+void PREFIX(get_stats)(struct liballoc_stats *stats)
+{
+	liballoc_lock();
+	stats->allocated = l_allocated;
+	stats->inuse = l_inuse;
+	stats->warnings = l_warningCount;
+	stats->errors = l_errorCount;
+	stats->possible_overruns = l_possibleOverruns;
+	liballoc_unlock();
+}
@@ -0,0 +1,105 @@
+#include <memory/memory_report.hpp>
+
+#include <stdint.h>
+#include <kernel/print.hpp>
+#include <memory/frame_allocator.hpp>
+#include <memory/heap_pages.hpp>
+#include <memory/kmalloc.hpp>
+#include <memory/liballoc.h>
+#include <util/array.hpp>
+
+namespace memory_report {
+    static constexpr Array<const char*, frame_allocator::ZONE_COUNT> ZONE_NAMES = {{
+        "DMA", "Normal", "High",
+    }};
+
+    static uint32_t to_kib(uint64_t bytes) {
+        return bytes / 1024;
+    }
+
+    /**
+     * Return the share of the free memory that is not in the largest
+     * free block, in percent. 0 is not fragmented at all.
+     */
+    static uint32_t get_fragmentation(uint64_t largest_free, uint64_t total_free) {
+        if (total_free == 0) {
+            return 0;
+        }
+        return (total_free - largest_free) * 100 / total_free;
+    }
+
+    static void print_frames() {
+        println("  Frames:");
+        for (size_t i = 0; i < frame_allocator::ZONE_COUNT; i++) {
+            auto stats = frame_allocator::get_zone_stats(static_cast<frame_allocator::Zone>(i));
+            if (stats.total_frames == 0) {
+                continue;
+            }
+
+            println("    {}: {} of {} free, largest free block {} ({}% fragmented)",
+                ZONE_NAMES[i], stats.free_frames, stats.total_frames,
+                stats.largest_free_block,
+                get_fragmentation(stats.largest_free_block, stats.free_frames));
+        }
+
+        auto cache_stats = frame_allocator::get_cache_stats();
+        println("    {} KiB available, peak use {} KiB, zeroed pool {} hits {} misses",
+            to_kib(frame_allocator::get_available_memory()),
+            to_kib(frame_allocator::get_peak_used_memory()),
+            cache_stats.zeroed_hits, cache_stats.zeroed_misses);
+    }
+
+    static void print_heap() {
+        println("  Heap: {} KiB mapped (peak {} KiB, limit {} KiB), {} KiB reserved",
+            to_kib(heap::get_mapped_memory()),
+            to_kib(heap::get_peak_mapped_memory()),
+            to_kib(heap::get_limit()),
+            to_kib(heap::get_reserved_memory()));
+
+        size_t free_space = heap::get_free_address_space();
+        size_t largest_range = heap::get_largest_free_range();
+        println("    Address space: {} KiB free, largest range {} KiB ({}% fragmented)",
+            to_kib(free_space), to_kib(largest_range),
+            get_fragmentation(largest_range, free_space));
+    }
+
+    static void print_kmalloc() {
+        auto stats = kmalloc_get_stats();
+        uint64_t page_bytes = static_cast<uint64_t>(stats.slab_pages + stats.large_pages)
+            * paging::PAGE_SIZE;
+        println("  kmalloc: {} KiB in use of {} KiB of pages",
+            to_kib(stats.bytes_in_use), to_kib(page_bytes));
+
+        for (size_t i = 0; i < kmalloc_get_class_count(); i++) {
+            auto class_stats = kmalloc_get_class_stats(i);
+            if (class_stats.allocations == 0 && class_stats.slabs == 0) {
+                continue;
+            }
+
+            println("    {} bytes: {} allocations, {} in use, {} slabs",
+                class_stats.object_size, class_stats.allocations,
+                class_stats.in_use, class_stats.slabs);
+        }
+
+        println("    Large: {} allocations, {} in use, {} pages",
+            stats.large_allocations, stats.large_in_use, stats.large_pages);
+    }
+
+    static void print_liballoc() {
+        liballoc_stats stats;
+        liballoc_kget_stats(&stats);
+        println("  liballoc: {} KiB in use of {} KiB, {} warnings, {} errors, {} possible overruns",
+            to_kib(stats.inuse), to_kib(stats.allocated),
+            static_cast<uint64_t>(stats.warnings),
+            static_cast<uint64_t>(stats.errors),
+            static_cast<uint64_t>(stats.possible_overruns));
+    }
+
+    void print() {
+        println("Memory report:");
+        print_frames();
+        print_heap();
+        print_kmalloc();
+        print_liballoc();
+    }
+}
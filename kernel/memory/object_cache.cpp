@@ -0,0 +1,234 @@
+#include <memory/object_cache.hpp>
+
+#include <kernel/log.hpp>
+#include <memory/heap_pages.hpp>
+#include <util/assert.hpp>
+
+static constexpr uint32_t SLAB_MAGIC = 0x0bca'c4e5;
+
+/**
+ * Header at the start of every slab page, followed by the bitmap
+ * of free objects and then the objects.
+ */
+struct ObjectCacheBase::Slab {
+    uint32_t magic;
+    ObjectCacheBase* cache;
+    Slab* prev;
+    Slab* next;
+    uint8_t* objects;
+    uint16_t capacity;
+    uint16_t used;
+
+    uint32_t* get_free_bitmap() {
+        return reinterpret_cast<uint32_t*>(this + 1);
+    }
+};
+
+static constexpr size_t get_bitmap_words(size_t object_count) {
+    return (object_count + 31) / 32;
+}
+
+/**
+ * Caches that have slabs.
+ */
+static ObjectCacheBase* first_cache = nullptr;
+
+/**
+ * Protects `first_cache` and the links between caches. Taken after
+ * a cache's own lock when it registers.
+ */
+static Spinlock caches_lock;
+
+void ObjectCacheBase::link(Slab*& list, Slab* slab) {
+    slab->prev = nullptr;
+    slab->next = list;
+    if (list) list->prev = slab;
+    list = slab;
+}
+
+void ObjectCacheBase::unlink(Slab*& list, Slab* slab) {
+    if (slab->prev) slab->prev->next = slab->next;
+    else list = slab->next;
+    if (slab->next) slab->next->prev = slab->prev;
+    slab->prev = nullptr;
+    slab->next = nullptr;
+}
+
+ObjectCacheBase::Slab* ObjectCacheBase::create_slab() {
+    void* page = heap::allocate_pages(1);
+    if (!page) {
+        return nullptr;
+    }
+
+    auto object_offset = [this](size_t capacity) {
+        return align_up(
+            sizeof(Slab) + get_bitmap_words(capacity) * sizeof(uint32_t),
+            object_alignment);
+    };
+
+    size_t capacity = (paging::PAGE_SIZE - sizeof(Slab)) / object_size;
+    while (object_offset(capacity) + capacity * object_size > paging::PAGE_SIZE) {
+        capacity--;
+    }
+
+    Slab* slab = new (page) Slab{
+        .magic = SLAB_MAGIC,
+        .cache = this,
+        .prev = nullptr,
+        .next = nullptr,
+        .objects = static_cast<uint8_t*>(page) + object_offset(capacity),
+        .capacity = static_cast<uint16_t>(capacity),
+        .used = 0,
+    };
+
+    uint32_t* bitmap = slab->get_free_bitmap();
+    for (size_t i = 0; i < get_bitmap_words(capacity); i++) {
+        bitmap[i] = 0;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        bitmap[i / 32] |= 1u << (i % 32);
+    }
+
+    if (construct) {
+        for (size_t i = 0; i < capacity; i++) {
+            construct(slab->objects + i * object_size);
+        }
+    }
+
+    if (!registered) {
+        SpinlockGuard guard(caches_lock);
+        next_cache = first_cache;
+        first_cache = this;
+        registered = true;
+    }
+
+    slab_count++;
+    return slab;
+}
+
+void ObjectCacheBase::destroy_slab(Slab* slab) {
+    ASSERT(slab->used == 0);
+
+    if (destroy) {
+        for (size_t i = 0; i < slab->capacity; i++) {
+            destroy(slab->objects + i * object_size);
+        }
+    }
+
+    slab->magic = 0;
+    heap::free_pages(slab, 1);
+    slab_count--;
+}
+
+void* ObjectCacheBase::allocate_object() {
+    SpinlockGuard guard(lock);
+
+    Slab* slab = partial;
+    if (!slab) {
+        if (empty) {
+            slab = empty;
+            unlink(empty, slab);
+        } else {
+            slab = create_slab();
+            if (!slab) return nullptr;
+        }
+        link(partial, slab);
+    }
+
+    uint32_t* bitmap = slab->get_free_bitmap();
+    size_t word = 0;
+    while (bitmap[word] == 0) {
+        word++;
+    }
+
+    size_t index = word * 32 + __builtin_ctz(bitmap[word]);
+    bitmap[word] &= ~(1u << (index % 32));
+    slab->used++;
+    used_count++;
+
+    if (slab->used == slab->capacity) {
+        unlink(partial, slab);
+        link(full, slab);
+    }
+
+    return slab->objects + index * object_size;
+}
+
+void ObjectCacheBase::free_object(void* object) {
+    if (!object) {
+        return;
+    }
+
+    SpinlockGuard guard(lock);
+
+    auto slab = reinterpret_cast<Slab*>(
+        reinterpret_cast<uintptr_t>(object) & ~(paging::PAGE_SIZE - 1));
+    if (slab->magic != SLAB_MAGIC || slab->cache != this) {
+        LOG_ERROR("Object {:p} does not belong to cache {}.", object, name);
+        return;
+    }
+
+    size_t offset = static_cast<uint8_t*>(object) - slab->objects;
+    ASSERT(offset % object_size == 0);
+    size_t index = offset / object_size;
+    ASSERT(index < slab->capacity);
+
+    uint32_t* bitmap = slab->get_free_bitmap();
+    uint32_t bit = 1u << (index % 32);
+    if (bitmap[index / 32] & bit) {
+        LOG_ERROR("Double free of {:p} in cache {}.", object, name);
+        return;
+    }
+
+    bitmap[index / 32] |= bit;
+    used_count--;
+
+    if (slab->used == slab->capacity) {
+        unlink(full, slab);
+        link(partial, slab);
+    }
+
+    slab->used--;
+    if (slab->used == 0) {
+        unlink(partial, slab);
+        link(empty, slab);
+    }
+}
+
+size_t ObjectCacheBase::reclaim() {
+    SpinlockGuard guard(lock);
+    return reclaim_locked();
+}
+
+size_t ObjectCacheBase::reclaim_locked() {
+    size_t freed = 0;
+    while (empty) {
+        Slab* slab = empty;
+        unlink(empty, slab);
+        destroy_slab(slab);
+        freed++;
+    }
+    return freed;
+}
+
+size_t ObjectCacheBase::reclaim_all() {
+    // This runs when the heap is out of memory, which may happen
+    // while a cache creates a slab, with its lock already held.
+    if (!caches_lock.try_lock()) {
+        return 0;
+    }
+
+    size_t freed = 0;
+    for (auto cache = first_cache; cache; cache = cache->next_cache) {
+        if (cache->lock.try_lock()) {
+            freed += cache->reclaim_locked();
+            cache->lock.unlock();
+        }
+    }
+    caches_lock.unlock();
+
+    if (freed > 0) {
+        LOG_INFO("Reclaimed {} pages from object caches.", freed);
+    }
+    return freed;
+}
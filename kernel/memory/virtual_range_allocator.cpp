@@ -0,0 +1,46 @@
+#include <memory/virtual_range_allocator.hpp>
+
+#include <util/assert.hpp>
+#include <util/math.hpp>
+
+VirtualRangeAllocator::VirtualRangeAllocator(
+    Span<uint32_t> storage, paging::VirtAddr start, paging::VirtAddr end, size_t max_order)
+    : pages(storage, (end - start) / paging::PAGE_SIZE, max_order), start(start), end(end)
+{
+    ASSERT(start % paging::PAGE_SIZE == 0);
+    ASSERT(end % paging::PAGE_SIZE == 0);
+    ASSERT(start <= end);
+
+    pages.free_range(0, pages.get_unit_count());
+}
+
+Option<paging::VirtAddr> VirtualRangeAllocator::allocate(size_t page_count, size_t alignment) {
+    ASSERT(page_count > 0);
+    ASSERT(alignment % paging::PAGE_SIZE == 0);
+    ASSERT((alignment & (alignment - 1)) == 0);
+
+    // Buddy blocks are aligned relative to the window start.
+    ASSERT(start % alignment == 0);
+
+    auto first = pages.allocate_range(page_count, ceil_log2(alignment / paging::PAGE_SIZE));
+    if (!first.has_value()) {
+        return {};
+    }
+
+    return start + first.get_value() * paging::PAGE_SIZE;
+}
+
+void VirtualRangeAllocator::free(paging::VirtAddr range_start, size_t page_count) {
+    ASSERT(range_start % paging::PAGE_SIZE == 0);
+    ASSERT(contains(range_start));
+    ASSERT(range_start + page_count * paging::PAGE_SIZE <= end);
+
+    pages.free_range((range_start - start) / paging::PAGE_SIZE, page_count);
+}
+
+bool VirtualRangeAllocator::is_allocated(paging::VirtAddr address) const {
+    if (!contains(address)) {
+        return false;
+    }
+    return !pages.is_free((address - start) / paging::PAGE_SIZE);
+}
@@ -0,0 +1,135 @@
+/**
+ * @file
+ *
+ * The compiler may also emit calls to these on its own.
+ *
+ * Copies and fills go through the string instructions: bytes up to
+ * a 4-byte aligned destination, then dwords, then the remaining
+ * bytes. With ERMS, a single `rep movsb`/`rep stosb` is faster for
+ * any size, the CPU picks the chunk size itself.
+ *
+ * Everything is in inline assembly, the compiler could turn plain
+ * loops back into calls to these functions.
+ */
+
+#include <util/memory.hpp>
+
+#include <stdint.h>
+#include <arch/i386/cpu.hpp>
+
+static bool use_erms = false;
+
+void init_memory_functions() {
+    use_erms = cpu::has_feature(cpu::Feature::ERMS);
+}
+
+/**
+ * Return the number of bytes before `dst` is 4-byte aligned,
+ * at most `size`.
+ */
+static inline size_t get_head_size(const void* dst, size_t size) {
+    size_t head = -reinterpret_cast<uintptr_t>(dst) & 3;
+    return head < size ? head : size;
+}
+
+extern "C" void* memcpy(void* dst, const void* src, size_t size) {
+    void* dst_iter = dst;
+    if (use_erms) {
+        asm volatile("rep movsb"
+            : "+D" (dst_iter), "+S" (src), "+c" (size)
+            :
+            : "memory");
+        return dst;
+    }
+
+    size_t head = get_head_size(dst, size);
+    size_t dwords = (size - head) / 4;
+    size_t tail = (size - head) % 4;
+    asm volatile(
+        "rep movsb\n\t"
+        "movl %[dwords], %%ecx\n\t"
+        "rep movsl\n\t"
+        "movl %[tail], %%ecx\n\t"
+        "rep movsb"
+        : "+D" (dst_iter), "+S" (src), "+c" (head)
+        : [dwords] "r" (dwords), [tail] "r" (tail)
+        : "memory");
+    return dst;
+}
+
+extern "C" void* memmove(void* dst, const void* src, size_t size) {
+    auto dst_addr = reinterpret_cast<uintptr_t>(dst);
+    auto src_addr = reinterpret_cast<uintptr_t>(src);
+
+    // Copying forwards only overwrites bytes already read.
+    if (dst_addr <= src_addr || dst_addr >= src_addr + size) {
+        return memcpy(dst, src, size);
+    }
+
+    // Backwards: the tail bytes from the last one, then the dwords.
+    auto dst_iter = reinterpret_cast<uint8_t*>(dst) + size - 1;
+    auto src_iter = reinterpret_cast<const uint8_t*>(src) + size - 1;
+    size_t tail = size % 4;
+    size_t dwords = size / 4;
+    asm volatile(
+        "std\n\t"
+        "rep movsb\n\t"
+        "subl $3, %%edi\n\t"
+        "subl $3, %%esi\n\t"
+        "movl %[dwords], %%ecx\n\t"
+        "rep movsl\n\t"
+        "cld"
+        : "+D" (dst_iter), "+S" (src_iter), "+c" (tail)
+        : [dwords] "r" (dwords)
+        : "memory", "cc");
+    return dst;
+}
+
+extern "C" void* memset(void* dst, int value, size_t size) {
+    void* dst_iter = dst;
+    uint32_t byte = static_cast<uint8_t>(value);
+    if (use_erms) {
+        asm volatile("rep stosb"
+            : "+D" (dst_iter), "+c" (size)
+            : "a" (byte)
+            : "memory");
+        return dst;
+    }
+
+    size_t head = get_head_size(dst, size);
+    size_t dwords = (size - head) / 4;
+    size_t tail = (size - head) % 4;
+    asm volatile(
+        "rep stosb\n\t"
+        "movl %[dwords], %%ecx\n\t"
+        "rep stosl\n\t"
+        "movl %[tail], %%ecx\n\t"
+        "rep stosb"
+        : "+D" (dst_iter), "+c" (head)
+        : "a" (byte * 0x0101'0101), [dwords] "r" (dwords), [tail] "r" (tail)
+        : "memory");
+    return dst;
+}
+
+extern "C" int memcmp(const void* lhs, const void* rhs, size_t size) {
+    using UnalignedWord [[gnu::may_alias, gnu::aligned(1)]] = uint32_t;
+
+    auto lhs_bytes = reinterpret_cast<const uint8_t*>(lhs);
+    auto rhs_bytes = reinterpret_cast<const uint8_t*>(rhs);
+
+    // Skip the equal dwords, the difference is found byte by byte.
+    size_t i = 0;
+    while (i + 4 <= size
+        && *reinterpret_cast<const UnalignedWord*>(lhs_bytes + i)
+            == *reinterpret_cast<const UnalignedWord*>(rhs_bytes + i))
+    {
+        i += 4;
+    }
+
+    for (; i < size; i++) {
+        if (lhs_bytes[i] != rhs_bytes[i]) {
+            return lhs_bytes[i] < rhs_bytes[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}